@@ -0,0 +1,150 @@
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "batch_manifest.hpp"
+#include "bounded_queue.hpp"
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "many_simulations.hpp"
+#include "spread_functions.cuh"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#define FILENAME_PREFIX "graphics/simdata/burned_probabilities_data_"
+
+struct LoadedRun {
+  BatchEntry entry;
+  std::shared_ptr<const LandscapeSoA> landscape;
+  std::shared_ptr<const IgnitionCells> ignition_cells;
+};
+
+struct RunResult {
+  std::string output_suffix;
+  size_t n_replicates;
+  Matrix<size_t> burned_amounts;
+};
+
+static void write_burned_amounts(const RunResult& result) {
+  TRACE_SPAN("write_burned_amounts", "output");
+  std::ofstream outputFile(FILENAME_PREFIX + result.output_suffix + ".txt");
+  outputFile << "Landscape size: " << result.burned_amounts.width << " " << result.burned_amounts.height << std::endl;
+  outputFile << "Simulations: " << result.n_replicates << std::endl;
+  for (size_t i = 0; i < result.burned_amounts.height; i++) {
+    for (size_t j = 0; j < result.burned_amounts.width; j++) {
+      if (j != 0) {
+        outputFile << " ";
+      }
+      outputFile << result.burned_amounts[{ j, i }];
+    }
+    outputFile << "\n";
+  }
+  outputFile.close();
+}
+
+/* Runs every entry of a manifest as a three stage pipeline:
+ *   loader thread -> (queue) -> simulation (main thread) -> (queue) -> writer thread
+ * so that parsing the next landscape and writing the previous results overlap with the current
+ * simulation. Each queue holds at most one run, which keeps memory flat however long the manifest
+ * is: at most two parsed landscapes, the one being simulated and the next one. Consecutive entries
+ * with the same landscape share one parsed copy.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <manifest.csv>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  BoundedQueue<LoadedRun> loaded(1);
+  BoundedQueue<RunResult> finished(1);
+  std::exception_ptr loader_error, writer_error;
+
+  try {
+    BatchManifest manifest = read_batch_manifest(argv[1]);
+
+    std::thread loader([&] {
+      try {
+        std::string last_prefix;
+        std::shared_ptr<const LandscapeSoA> landscape;
+        std::shared_ptr<const IgnitionCells> ignition_cells;
+        for (const BatchEntry& entry : manifest) {
+          if (!landscape || entry.landscape_prefix != last_prefix) {
+            // Drop the loader's reference so the previous landscape is freed as soon as its last run
+            // finishes. That run may still be simulating (or queued) while the next one is parsed,
+            // so up to two landscapes are alive at once.
+            landscape.reset();
+            landscape = std::make_shared<const LandscapeSoA>(
+                entry.landscape_prefix + "-metadata.csv", entry.landscape_prefix + "-landscape.csv"
+            );
+            ignition_cells = std::make_shared<const IgnitionCells>(
+                read_ignition_cells(entry.landscape_prefix + "-ignition_points.csv")
+            );
+            last_prefix = entry.landscape_prefix;
+          }
+          if (!loaded.push({ entry, landscape, ignition_cells })) {
+            break;
+          }
+        }
+      } catch (...) {
+        loader_error = std::current_exception();
+      }
+      loaded.close();
+    });
+
+    std::thread writer([&] {
+      try {
+        while (std::optional<RunResult> result = finished.pop()) {
+          write_burned_amounts(*result);
+        }
+      } catch (...) {
+        writer_error = std::current_exception();
+        finished.close();
+      }
+    });
+
+    try {
+      while (std::optional<LoadedRun> run = loaded.pop()) {
+        TRACE_SPAN("batch_run", "simulation");
+        std::cout << "Running " << run->entry.landscape_prefix << " (" << run->entry.output_suffix << ")" << std::endl;
+        Matrix<size_t> burned_amounts = burned_amounts_per_cell(
+            *run->landscape, *run->ignition_cells, run->entry.params, DISTANCE, ELEVATION_MEAN,
+            ELEVATION_SD, UPPER_LIMIT, run->entry.n_replicates, run->entry.output_suffix
+        );
+        if (!finished.push({ run->entry.output_suffix, run->entry.n_replicates, std::move(burned_amounts) })) {
+          break;
+        }
+      }
+    } catch (...) {
+      loaded.close();
+      finished.close();
+      loader.join();
+      writer.join();
+      throw;
+    }
+
+    loaded.close();
+    finished.close();
+    loader.join();
+    writer.join();
+
+    if (loader_error) {
+      std::rethrow_exception(loader_error);
+    }
+    if (writer_error) {
+      std::rethrow_exception(writer_error);
+    }
+  } catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -1,11 +1,18 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <cstdlib>
+#include <memory>
 
+#include "fire_archive.hpp"
 #include "ignition_cells.hpp"
 #include "landscape.hpp"
 #include "many_simulations.hpp"
+#include "memory_accounting.hpp"
+#include "memory_plan.hpp"
+#include "result_cache.hpp"
 #include "spread_functions.cuh"
+#include "trace.hpp"
 
 #define DISTANCE 30.0f
 #define ELEVATION_MEAN 1163.3f
@@ -15,13 +22,14 @@
 #define N_REPLICATES 100
 #endif
 #define FILENAME "graphics/simdata/burned_probabilities_data.txt"
+#define ARCHIVE_QUEUE_CAPACITY 64
 
 int main(int argc, char* argv[]) {
   try {
 
     // check if the number of arguments is correct
-    if (argc != 3) {
-      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <output_filename_suffix>" << std::endl;
+    if (argc != 3 && argc != 4) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <output_filename_suffix> [fire_archive]" << std::endl;
       return EXIT_FAILURE;
     }
 
@@ -31,6 +39,7 @@ int main(int argc, char* argv[]) {
 
     // read the landscape
     LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+    MemoryUsage landscape_usage(MemoryComponent::LANDSCAPE, landscape.bytes());
 
     // read the ignition cells
     IgnitionCells ignition_cells =
@@ -40,10 +49,62 @@ int main(int argc, char* argv[]) {
       0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
     };
 
-    Matrix<size_t> burned_amounts = burned_amounts_per_cell(
-        landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, N_REPLICATES, output_filename_suffix
-    );
+    // with FIRE_SPREAD_CACHE=<directory>, batches of replicates already simulated with the same
+    // landscape and parameters are read from there (not when archiving, which needs every fire)
+    const char* cache_directory = std::getenv("FIRE_SPREAD_CACHE");
+
+    // with FIRE_SPREAD_MEMORY_BUDGET=<MB> (and FIRE_SPREAD_DEVICE_MEMORY_BUDGET=<MB>), fewer fires
+    // are queued for the archive if needed, and the run is refused if it still doesn't fit
+    MemoryPlanRequest request;
+    request.width = landscape.width;
+    request.height = landscape.height;
+    request.engine = EnsembleEngine::GPU;
+    request.n_replicates = N_REPLICATES;
+    request.archive_queue_capacity = argc == 4 ? ARCHIVE_QUEUE_CAPACITY : 0;
+    request.checkpoint = std::getenv("FIRE_SPREAD_CHECKPOINT") && argc != 4 && !cache_directory;
+    MemoryPlan plan = fit_memory_budget(request, memory_budget_from_env());
+    print_memory_plan(plan, std::cout);
+
+    // optionally keep every simulated fire, e.g. to compute other metrics later
+    std::unique_ptr<FireArchiveWriter> archive;
+    if (argc == 4) {
+      archive = std::make_unique<FireArchiveWriter>(
+          argv[3], landscape.width, landscape.height, plan.request.archive_queue_capacity
+      );
+    }
+
+    Matrix<size_t> burned_amounts(landscape.width, landscape.height);
+    if (cache_directory && !archive) {
+      ResultCache cache(cache_directory);
+      burned_amounts = cached_burned_amounts_per_cell(
+          cache, landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, N_REPLICATES, output_filename_suffix
+      );
+      std::cout << "* Cached batches: " << cache.hits << " of " << cache.hits + cache.misses << std::endl;
+    } else {
+      // with FIRE_SPREAD_CHECKPOINT=<file>, the counts are checkpointed every
+      // FIRE_SPREAD_CHECKPOINT_INTERVAL seconds (60 by default), and with FIRE_SPREAD_RESUME=1 a run
+      // continues from that file (not when archiving, the fires before the checkpoint would be lost)
+      const char* checkpoint_file = std::getenv("FIRE_SPREAD_CHECKPOINT");
+      std::unique_ptr<CheckpointOptions> checkpoint;
+      if (checkpoint_file && !archive) {
+        checkpoint = std::make_unique<CheckpointOptions>();
+        checkpoint->filename = checkpoint_file;
+        if (const char* interval = std::getenv("FIRE_SPREAD_CHECKPOINT_INTERVAL")) {
+          checkpoint->interval_seconds = std::atof(interval);
+        }
+        const char* resume = std::getenv("FIRE_SPREAD_RESUME");
+        checkpoint->resume = resume && std::string(resume) == "1";
+      }
+      burned_amounts = burned_amounts_per_cell(
+          landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, N_REPLICATES, output_filename_suffix,
+          archive.get(), 0, checkpoint.get()
+      );
+    }
+    if (archive) {
+      archive->close();
+    }
     // Abrir el archivo de salida y crear la cadena con información
+    TRACE_SPAN("write_burned_amounts", "output");
     std::ofstream outputFile(FILENAME);
     outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
     outputFile << "Simulations: " << N_REPLICATES << std::endl;
@@ -59,10 +120,14 @@ int main(int argc, char* argv[]) {
     }
     // Cerrar archivo de salida
     outputFile.close();
+
+    report_memory_usage(std::cout);
   } catch (std::runtime_error& e) {
     std::cerr << "ERROR: " << e.what() << std::endl;
     return EXIT_FAILURE;
   }
 
+  trace::flush();
+
   return EXIT_SUCCESS;
 }
\ No newline at end of file
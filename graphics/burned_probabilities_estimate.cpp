@@ -0,0 +1,105 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+
+#include <omp.h>
+
+#include "burn_estimator.hpp"
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "memory_accounting.hpp"
+#include "memory_plan.hpp"
+#include "numa.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#define FILENAME "graphics/simdata/burned_probabilities_estimate.txt"
+
+// Burn probabilities and their standard errors with plain Monte Carlo, antithetic pairs or
+// stratified blocks (see burn_estimator.hpp)
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 4 && argc != 5) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <mc|antithetic|stratified> <n_blocks> [block_size]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+    EdgeStream stream = parse_edge_stream(argv[2]);
+    size_t n_blocks = std::stoul(argv[3]);
+    size_t block_size = argc == 5 ? std::stoul(argv[4]) : 8;
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+    MemoryUsage landscape_usage(MemoryComponent::LANDSCAPE, landscape.bytes());
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    // with FIRE_SPREAD_MEMORY_BUDGET=<MB>, fewer threads run if needed, and the run is refused if
+    // a single one doesn't fit
+    MemoryPlanRequest request;
+    request.width = landscape.width;
+    request.height = landscape.height;
+    request.engine = EnsembleEngine::CPU_ESTIMATOR;
+    request.n_threads = omp_get_max_threads();
+    request.n_replicates = n_blocks * block_size;
+    if (numa_config_from_env().placement == NumaPlacement::REPLICATE) {
+      request.n_landscape_copies = detect_numa_topology().n_nodes();
+    }
+    MemoryPlan plan = fit_memory_budget(request, memory_budget_from_env());
+    omp_set_num_threads(plan.request.n_threads);
+    print_memory_plan(plan, std::cout);
+
+    BurnProbabilityEstimate estimate = estimate_burn_probabilities(
+        landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, stream, n_blocks, block_size
+    );
+
+    double max_error = 0;
+    for (double error : estimate.standard_error.elems) {
+      max_error = std::max(max_error, error);
+    }
+
+    std::cout << "  BURN PROBABILITY ESTIMATE (" << argv[2] << ")" << std::endl;
+    std::cout << "* Simulations: " << estimate.n_replicates << std::endl;
+    std::cout << "* Max standard error: " << max_error << std::endl;
+    std::cout << "* Speed-up over plain Monte Carlo: " << estimate.speedup << "x" << std::endl;
+
+    // Probabilities followed by their standard errors, one row of the landscape per line
+    TRACE_SPAN("write_burn_probabilities", "output");
+    std::ofstream outputFile(FILENAME);
+    outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
+    outputFile << "Simulations: " << estimate.n_replicates << std::endl;
+    for (const Matrix<double>* layer : { &estimate.probability, &estimate.standard_error }) {
+      for (size_t i = 0; i < landscape.height; i++) {
+        for (size_t j = 0; j < landscape.width; j++) {
+          if (j != 0) {
+            outputFile << " ";
+          }
+          outputFile << (*layer)[{j, i}];
+        }
+        outputFile << std::endl;
+      }
+    }
+    outputFile.close();
+
+    report_memory_usage(std::cout);
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
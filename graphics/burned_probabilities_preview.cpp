@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <fstream>
+
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "landscape_pyramid.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#define N_PILOT 32
+#define FILENAME "graphics/simdata/burned_probabilities_preview.txt"
+
+// Rough burn probabilities on a coarser level of the landscape pyramid, optionally refined at full
+// resolution where they are high (see landscape_pyramid.hpp)
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 4 && argc != 5) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <level> <n_replicates> [refine_threshold]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+    size_t level = std::stoul(argv[2]);
+    size_t n_replicates = std::stoul(argv[3]);
+    double refine_threshold = argc == 5 ? std::stod(argv[4]) : 0.0;
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    // the intercept of the coarse level is calibrated with N_PILOT replicates at full resolution,
+    // FIRE_SPREAD_PREVIEW_PILOT=<n> uses n instead (0 turns the calibration off)
+    const char* pilot = std::getenv("FIRE_SPREAD_PREVIEW_PILOT");
+    size_t n_pilot = pilot ? std::stoul(pilot) : N_PILOT;
+
+    auto start = std::chrono::steady_clock::now();
+    BurnProbabilityPreview preview = preview_burn_probabilities(
+        landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, level, n_replicates, refine_threshold, n_pilot
+    );
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "  BURN PROBABILITY PREVIEW (" << preview.factor << "x coarser)" << std::endl;
+    std::cout << "* Simulations: " << preview.n_replicates << std::endl;
+    std::cout << "* Intercept shift on the coarse level: " << preview.intercept_shift << std::endl;
+    if (preview.refined) {
+      std::cout << "* Refined at full resolution: " << preview.refined->width << "x" << preview.refined->height
+                << " cells from (" << preview.refined->x0 << ", " << preview.refined->y0 << ")" << std::endl;
+    }
+    std::cout << "* Time taken: " << seconds << " seconds" << std::endl;
+
+    // Probabilities at the resolution of the landscape, one row per line
+    TRACE_SPAN("write_burn_probabilities", "output");
+    std::ofstream outputFile(FILENAME);
+    outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
+    outputFile << "Simulations: " << preview.n_replicates << std::endl;
+    for (size_t i = 0; i < landscape.height; i++) {
+      for (size_t j = 0; j < landscape.width; j++) {
+        if (j != 0) {
+          outputFile << " ";
+        }
+        outputFile << preview.probability[{j, i}];
+      }
+      outputFile << std::endl;
+    }
+    outputFile.close();
+  } catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
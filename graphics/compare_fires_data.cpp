@@ -0,0 +1,69 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "fire_archive.hpp"
+#include "fire_comparison.hpp"
+#include "fires.hpp"
+#include "landscape.hpp"
+#include "trace.hpp"
+
+// Simulated fires read from the archive and scored at a time
+#define BATCH_SIZE 256
+
+// Scores an observed fire against every fire of an archive (see burned_probabilities_data)
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 4) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <observed_fire.csv> <fire_archive>" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+    VegetationMasks masks = vegetation_masks(landscape);
+
+    Fire observed = read_fire(landscape.width, landscape.height, argv[2]);
+    FireArchiveReader archive(argv[3]);
+
+    double comparison_time = 0;
+    const std::vector<size_t>& replicates = archive.replicates();
+
+    std::cout << "replicate,jaccard,size_ratio,intersection,matorral,subalpine,wet,dry" << std::endl;
+    for (size_t first = 0; first < replicates.size(); first += BATCH_SIZE) {
+      size_t last = std::min(first + BATCH_SIZE, replicates.size());
+
+      std::vector<Fire> simulated;
+      for (size_t r = first; r < last; r++) {
+        simulated.push_back(archive.read_fire(replicates[r]));
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<FireComparison> comparisons = compare_fires(observed, simulated, masks);
+      comparison_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      for (size_t f = 0; f < comparisons.size(); f++) {
+        const FireComparison& c = comparisons[f];
+        std::cout << replicates[first + f] << "," << c.overlap.jaccard << "," << c.overlap.size_ratio
+                  << "," << c.overlap.intersection << "," << c.simulated_stats.counts_veg_matorral
+                  << "," << c.simulated_stats.counts_veg_subalpine << ","
+                  << c.simulated_stats.counts_veg_wet << "," << c.simulated_stats.counts_veg_dry
+                  << std::endl;
+      }
+    }
+
+    std::cerr << "* Compared fires: " << replicates.size() << std::endl;
+    std::cerr << "* Comparison time: " << comparison_time << " seconds" << std::endl;
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "derived_layers.hpp"
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#ifndef N_REPLICATES
+#define N_REPLICATES 100
+#endif
+#define FILENAME "graphics/simdata/derived_layers_data.txt"
+
+// Burn probabilities on the host engine reading the landscape terms from the derived layers
+// sidecar `<landscape_file_prefix>-derived.bin`, which is created on the first run
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 2) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix>" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+    LandscapeView view = landscape.view();
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    auto start = std::chrono::steady_clock::now();
+    DerivedLayers derived = DerivedLayers::open_or_build(
+      view, landscape_file_prefix + "-derived.bin", DISTANCE, ELEVATION_MEAN, ELEVATION_SD
+    );
+    double setup_time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DerivedView derived_view = derived.view();
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    Matrix<size_t> burned_amounts(landscape.width, landscape.height);
+    double total_time_taken = 0;
+    double plain_time_taken = 0;
+    bool same = true;
+
+    for (size_t i = 0; i < N_REPLICATES; i++) {
+      TRACE_SPAN("replicate", "simulation", "replicate", i);
+      start = std::chrono::steady_clock::now();
+      Fire fire = simulate_fire_cpu(view, derived_view, ignition_cells, params, i, UPPER_LIMIT);
+      total_time_taken += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      for (uint32_t idx : fire.burned_cells) {
+        burned_amounts.elems[idx]++;
+      }
+
+      // the first replicate is also simulated computing every term on the fly, to check and compare
+      if (i == 0) {
+        start = std::chrono::steady_clock::now();
+        Fire plain = simulate_fire_cpu(
+          view, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, i, UPPER_LIMIT
+        );
+        plain_time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        same = plain == fire && plain.burned_ids_steps == fire.burned_ids_steps &&
+               plain.processed_cells == fire.processed_cells;
+      }
+    }
+
+    std::cout << "  DERIVED LAYERS" << std::endl;
+    std::cout << "* Derived layers " << (derived.computed() ? "computed" : "read from the sidecar")
+              << " in: " << setup_time_taken << " seconds" << std::endl;
+    std::cout << "* Total time taken: " << total_time_taken << " seconds" << std::endl;
+    std::cout << "* Average time per replicate: " << total_time_taken / N_REPLICATES << " seconds" << std::endl;
+    std::cout << "* Terms computed on the fly (first replicate): " << plain_time_taken << " seconds" << std::endl;
+    std::cout << "* Matches terms computed on the fly: " << (same ? "yes" : "no") << std::endl;
+
+    TRACE_SPAN("write_burned_probabilities", "output");
+    std::ofstream outputFile(FILENAME);
+    outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
+    outputFile << "Simulations: " << N_REPLICATES << std::endl;
+    for (size_t i = 0; i < landscape.height; i++) {
+      for (size_t j = 0; j < landscape.width; j++) {
+        if (j != 0) {
+          outputFile << " ";
+        }
+        outputFile << burned_amounts[{j, i}] / (double)N_REPLICATES;
+      }
+      outputFile << std::endl;
+    }
+    outputFile.close();
+
+    if (!same) {
+      throw std::runtime_error("Derived layers change the simulated fire");
+    }
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "distributed_spread.hpp"
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+
+// Sorts the cells inside each step, the order within a step depends on the traversal
+static std::vector<size_t> sorted_steps(const Fire& fire) {
+  std::vector<size_t> ids;
+  size_t begin = 0;
+  for (size_t end : fire.burned_ids_steps) {
+    size_t first = ids.size();
+    for (size_t b = begin; b < end; b++) {
+      ids.push_back(fire.burned_cells[b]);
+    }
+    std::sort(ids.begin() + first, ids.end());
+    begin = end;
+  }
+  return ids;
+}
+
+// Simulates one fire split in strips across `n_processes` local processes (connected by sockets)
+// and checks that it matches the single-process host simulation
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 3 && argc != 4) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <n_processes> [replicate]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+    int n_processes = std::stoi(argv[2]);
+    int replicate = argc == 4 ? std::stoi(argv[3]) : 0;
+    if (n_processes < 1) {
+      std::cerr << "n_processes must be at least 1" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string metadata_filename = landscape_file_prefix + "-metadata.csv";
+    std::string data_filename = landscape_file_prefix + "-landscape.csv";
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    std::vector<std::vector<int>> mesh = SocketTransport::local_mesh(n_processes);
+    std::vector<pid_t> workers;
+    for (int rank = 1; rank < n_processes; rank++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        for (pid_t worker : workers) {
+          kill(worker, SIGKILL);
+          waitpid(worker, nullptr, 0);
+        }
+        throw std::runtime_error("Can't fork simulation process");
+      }
+      if (pid == 0) {
+        // Leave only through _exit, never by unwinding into the parent's frames
+        int status = EXIT_FAILURE;
+        try {
+          SocketTransport transport = SocketTransport::from_local_mesh(mesh, rank);
+          LandscapeStrip strip =
+              load_landscape_strip(metadata_filename, data_filename, rank, n_processes);
+          simulate_fire_distributed(
+            transport, strip, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, replicate, UPPER_LIMIT
+          );
+          status = EXIT_SUCCESS;
+        } catch (std::exception& e) {
+          std::cerr << "ERROR (rank " << rank << "): " << e.what() << std::endl;
+        } catch (...) {
+          std::cerr << "ERROR (rank " << rank << "): unknown exception" << std::endl;
+        }
+        _exit(status);
+      }
+      workers.push_back(pid);
+    }
+
+    SocketTransport transport = SocketTransport::from_local_mesh(mesh, 0);
+    LandscapeStrip strip = load_landscape_strip(metadata_filename, data_filename, 0, n_processes);
+    Fire distributed = simulate_fire_distributed(
+      transport, strip, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, replicate, UPPER_LIMIT
+    );
+
+    for (pid_t pid : workers) {
+      int status;
+      if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("A simulation process failed");
+      }
+    }
+
+    LandscapeSoA landscape(metadata_filename, data_filename);
+    Fire single = simulate_fire_cpu(
+      landscape.view(), ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, replicate, UPPER_LIMIT
+    );
+
+    bool same = distributed.burned_ids_steps == single.burned_ids_steps &&
+                sorted_steps(distributed) == sorted_steps(single) &&
+                distributed.processed_cells == single.processed_cells;
+
+    std::cout << "  DISTRIBUTED SIMULATION (" << n_processes << " processes)" << std::endl;
+    std::cout << "* Burned cells: " << distributed.n_burned() << std::endl;
+    std::cout << "* Steps: " << distributed.burned_ids_steps.size() << std::endl;
+    std::cout << "* Time taken: " << distributed.time_taken << " seconds (single process: " << single.time_taken << ")" << std::endl;
+    std::cout << "* Matches single process run: " << (same ? "yes" : "NO") << std::endl;
+
+    trace::flush();
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
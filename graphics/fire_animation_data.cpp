@@ -7,6 +7,7 @@
 #include "landscape.hpp"
 #include "many_simulations.hpp"
 #include "spread_functions.cuh"
+#include "trace.hpp"
 
 #define DISTANCE 30
 #define ELEVATION_MEAN 1163.3
@@ -48,9 +49,14 @@ int main(int argc, char* argv[]) {
     int n_row = landscape.height;
     int n_col = landscape.width;
     Fire fire = empty_fire(n_row, n_col);
+    // The steps of the last replicate are written out below
+    SpreadOptions options;
+    options.record_steps = true;
     for (size_t i = 0; i < N_REPLICATES; i++) {
-      Fire fire = simulate_fire(
-        landscape, n_row, n_col, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, i, UPPER_LIMIT
+      TRACE_SPAN("replicate", "simulation", "replicate", i);
+      simulate_fire(
+        landscape.view(), ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, i, UPPER_LIMIT,
+        fire, options
       );
       double time_taken = fire.time_taken;
       double metric = fire.processed_cells / (time_taken * 1e6);
@@ -71,6 +77,7 @@ int main(int argc, char* argv[]) {
     perfOutputFile.close();
 
     // Abrir el archivo de salida y crear la cadena con información
+    TRACE_SPAN("write_fire_steps", "output");
     std::ofstream outputFile(FILENAME);
     outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
     size_t step = 0;
@@ -81,7 +88,7 @@ int main(int argc, char* argv[]) {
       }
       outputFile << "Step " << step << ":" << std::endl;
       for (; i < j; i++) {
-        outputFile << fire.burned_ids_0[i] << " " << fire.burned_ids_1[i] << std::endl;
+        outputFile << fire.burned_ids_0()[i] << " " << fire.burned_ids_1()[i] << std::endl;
       }
       step++;
     }
@@ -91,5 +98,7 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
+  trace::flush();
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+
+#include "fire_archive.hpp"
+#include "fires.hpp"
+
+// Summary of a fire archive, or the burned cells of one of its replicates
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 2 && argc != 3) {
+      std::cerr << "Usage: " << argv[0] << " <fire_archive> [replicate]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    FireArchiveReader archive(argv[1]);
+
+    if (argc == 3) {
+      ArchivedFire fire = archive.read(std::stoul(argv[2]));
+      std::cout << "Landscape size: " << archive.width() << " " << archive.height() << std::endl;
+      for (uint32_t idx : fire.burned_cells) {
+        std::cout << idx % archive.width() << " " << idx / archive.width() << std::endl;
+      }
+      return EXIT_SUCCESS;
+    }
+
+    size_t total_bytes = 0;
+    std::cout << "replicate,seed,burned_cells,steps,record_bytes" << std::endl;
+    for (size_t replicate : archive.replicates()) {
+      ArchivedFire fire = archive.read(replicate);
+      total_bytes += archive.record_bytes(replicate);
+      std::cout << replicate << "," << fire.seed << "," << fire.burned_cells.size() << ","
+                << fire.step_sizes.size() << "," << archive.record_bytes(replicate) << std::endl;
+    }
+
+    size_t n_fires = archive.replicates().size();
+    size_t dense_bytes = n_fires * archive.width() * archive.height() * sizeof(int);
+    std::cerr << "* Fires: " << n_fires << std::endl;
+    std::cerr << "* Archive records: " << total_bytes << " bytes (dense layers: " << dense_bytes << " bytes)" << std::endl;
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
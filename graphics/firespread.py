@@ -0,0 +1,242 @@
+"""
+    Python bindings of libfirespread.so (the C API of src/firespread.h)
+    Results are NumPy arrays over the buffers of the library, without copies: the
+    arrays of a Fire or an Ensemble are valid until it is simulated into again,
+    copy them (`array.copy()`) to keep them longer
+
+    Build the library with `make libfirespread.so`, or point FIRESPREAD_LIBRARY to it
+
+    Usage:
+    python firespread.py <landscape_file_prefix> [n_replicates] [gpu|cpu]
+
+    As a module:
+    landscape = firespread.Landscape.load("./data/2015_50")
+    landscape.prepare(firespread.MODEL)
+    ignitions = firespread.read_ignition_cells("./data/2015_50")
+    ensemble = firespread.Ensemble()
+    ensemble.simulate(landscape, ignitions, params, firespread.MODEL, 0, 100, firespread.CPU)
+    probabilities = ensemble.burned_amounts / ensemble.n_replicates
+"""
+
+import ctypes
+import os
+import sys
+import numpy as np
+
+LIBRARY = os.environ.get(
+    "FIRESPREAD_LIBRARY",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "libfirespread.so"),
+)
+
+GPU = 0
+CPU = 1
+
+class Params(ctypes.Structure):
+    """ Same fields as SimulationParams """
+    _fields_ = [(name, ctypes.c_float) for name in (
+        "independent_pred", "wind_pred", "elevation_pred", "slope_pred", "subalpine_pred",
+        "wet_pred", "dry_pred", "fwi_pred", "aspect_pred",
+    )]
+
+class Model(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_float) for name in (
+        "distance", "elevation_mean", "elevation_sd", "upper_limit",
+    )]
+
+# Constants used by the mains
+MODEL = Model(30.0, 1163.3, 399.5, 0.5)
+
+_size_p = ctypes.POINTER(ctypes.c_size_t)
+_float_p = ctypes.POINTER(ctypes.c_float)
+
+_lib = ctypes.CDLL(LIBRARY)
+
+def _declare(name, restype, *argtypes):
+    function = getattr(_lib, name)
+    function.restype = restype
+    function.argtypes = list(argtypes)
+
+_declare("fs_api_version", ctypes.c_int)
+_declare("fs_last_error", ctypes.c_char_p)
+_declare("fs_landscape_load", ctypes.c_void_p, ctypes.c_char_p)
+_declare("fs_landscape_from_arrays", ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t,
+         _float_p, _float_p, _float_p, _float_p, _float_p, ctypes.POINTER(ctypes.c_uint8))
+_declare("fs_landscape_free", None, ctypes.c_void_p)
+_declare("fs_landscape_width", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_landscape_height", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_landscape_prepare", ctypes.c_int, ctypes.c_void_p, ctypes.POINTER(Model),
+         ctypes.c_char_p)
+_declare("fs_read_ignition_cells", ctypes.c_long, ctypes.c_char_p, _size_p, ctypes.c_size_t)
+_declare("fs_fire_new", ctypes.c_void_p)
+_declare("fs_fire_free", None, ctypes.c_void_p)
+_declare("fs_simulate_fire", ctypes.c_int, ctypes.c_void_p, _size_p, ctypes.c_size_t,
+         ctypes.POINTER(Params), ctypes.POINTER(Model), ctypes.c_int, ctypes.c_int, ctypes.c_void_p)
+_declare("fs_fire_width", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_fire_height", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_fire_processed_cells", ctypes.c_uint, ctypes.c_void_p)
+_declare("fs_fire_time_taken", ctypes.c_double, ctypes.c_void_p)
+_declare("fs_fire_n_burned", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_fire_burned_cells", ctypes.c_void_p, ctypes.c_void_p)
+_declare("fs_fire_arrival_steps", ctypes.c_void_p, ctypes.c_void_p)
+_declare("fs_ensemble_new", ctypes.c_void_p)
+_declare("fs_ensemble_free", None, ctypes.c_void_p)
+_declare("fs_simulate_ensemble", ctypes.c_int, ctypes.c_void_p, _size_p, ctypes.c_size_t,
+         ctypes.POINTER(Params), ctypes.POINTER(Model), ctypes.c_size_t, ctypes.c_size_t,
+         ctypes.c_int, ctypes.c_void_p)
+_declare("fs_ensemble_width", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_ensemble_height", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_ensemble_n_replicates", ctypes.c_size_t, ctypes.c_void_p)
+_declare("fs_ensemble_burned_amounts", ctypes.c_void_p, ctypes.c_void_p)
+
+def _check(result):
+    """ Raises the last error of the library if `result` is an error (NULL or -1) """
+    if result is None or result < 0:
+        raise RuntimeError(_lib.fs_last_error().decode())
+    return result
+
+def _array(owner, address, ctype, shape):
+    """
+    Array of the given shape over a buffer of the library at `address`, which keeps `owner`
+    (the object that owns the buffer) alive
+    """
+    count = int(np.prod(shape))
+    if count == 0 or not address:
+        return np.zeros(shape, dtype=ctype)
+    buffer = (ctype * count).from_address(address)
+    buffer._owner = owner
+    return np.frombuffer(buffer, dtype=ctype).reshape(shape)
+
+def _ignitions(ignition_cells):
+    cells = np.ascontiguousarray(ignition_cells, dtype=np.uintp).reshape(-1, 2)
+    return cells, cells.ctypes.data_as(_size_p), len(cells)
+
+def read_ignition_cells(prefix: str) -> np.ndarray:
+    """ Ignition cells of <prefix>-ignition_points.csv, one (x, y) row per cell """
+    count = _check(_lib.fs_read_ignition_cells(prefix.encode(), None, 0))
+    cells = np.zeros((count, 2), dtype=np.uintp)
+    _check(_lib.fs_read_ignition_cells(prefix.encode(), cells.ctypes.data_as(_size_p), count))
+    return cells
+
+class Landscape:
+    def __init__(self, handle):
+        self._handle = _check(handle)
+
+    @staticmethod
+    def load(prefix: str) -> "Landscape":
+        return Landscape(_lib.fs_landscape_load(prefix.encode()))
+
+    @staticmethod
+    def from_arrays(elevation, fwi, aspect, vegetation_type, wind_dir, burnable) -> "Landscape":
+        """ Layers of shape (height, width), they are copied into the library """
+        layers = [np.ascontiguousarray(layer, dtype=np.float32)
+                  for layer in (elevation, fwi, aspect, vegetation_type, wind_dir)]
+        burnable = np.ascontiguousarray(burnable, dtype=np.uint8)
+        height, width = burnable.shape
+        return Landscape(_lib.fs_landscape_from_arrays(
+            width, height, *[layer.ctypes.data_as(_float_p) for layer in layers],
+            burnable.ctypes.data_as(ctypes.POINTER(ctypes.c_uint8))))
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.fs_landscape_free(self._handle)
+
+    @property
+    def width(self) -> int:
+        return _lib.fs_landscape_width(self._handle)
+
+    @property
+    def height(self) -> int:
+        return _lib.fs_landscape_height(self._handle)
+
+    def prepare(self, model: Model, sidecar_filename: str = None):
+        """ Derived layers needed by the CPU engine, cached in `sidecar_filename` if given """
+        sidecar = sidecar_filename.encode() if sidecar_filename else None
+        _check(_lib.fs_landscape_prepare(self._handle, ctypes.byref(model), sidecar))
+
+class Fire:
+    def __init__(self):
+        self._handle = _check(_lib.fs_fire_new())
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.fs_fire_free(self._handle)
+
+    def simulate(self, landscape: Landscape, ignition_cells, params: Params, model: Model,
+                 n_replicate: int, engine: int = GPU) -> "Fire":
+        array, cells, count = _ignitions(ignition_cells)  # array keeps the cells alive
+        _check(_lib.fs_simulate_fire(landscape._handle, cells, count, ctypes.byref(params),
+                                     ctypes.byref(model), n_replicate, engine, self._handle))
+        return self
+
+    @property
+    def shape(self):
+        return (_lib.fs_fire_height(self._handle), _lib.fs_fire_width(self._handle))
+
+    @property
+    def processed_cells(self) -> int:
+        return _lib.fs_fire_processed_cells(self._handle)
+
+    @property
+    def time_taken(self) -> float:
+        return _lib.fs_fire_time_taken(self._handle)
+
+    @property
+    def burned_cells(self) -> np.ndarray:
+        """ Linear indices (x + y * width) of the burned cells, in the order they burned """
+        count = _lib.fs_fire_n_burned(self._handle)
+        return _array(self, _lib.fs_fire_burned_cells(self._handle), ctypes.c_uint32, (count,))
+
+    @property
+    def arrival_steps(self) -> np.ndarray:
+        """ Step at which every cell burned, -1 if it did not burn, of shape (height, width) """
+        steps = _lib.fs_fire_arrival_steps(self._handle)
+        if np.prod(self.shape) > 0:
+            _check(steps)
+        return _array(self, steps, ctypes.c_int32, self.shape)
+
+class Ensemble:
+    def __init__(self):
+        self._handle = _check(_lib.fs_ensemble_new())
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.fs_ensemble_free(self._handle)
+
+    def simulate(self, landscape: Landscape, ignition_cells, params: Params, model: Model,
+                 first_replicate: int, n_replicates: int, engine: int = GPU) -> "Ensemble":
+        array, cells, count = _ignitions(ignition_cells)  # array keeps the cells alive
+        _check(_lib.fs_simulate_ensemble(landscape._handle, cells, count, ctypes.byref(params),
+                                         ctypes.byref(model), first_replicate, n_replicates,
+                                         engine, self._handle))
+        return self
+
+    @property
+    def n_replicates(self) -> int:
+        return _lib.fs_ensemble_n_replicates(self._handle)
+
+    @property
+    def burned_amounts(self) -> np.ndarray:
+        """ Times every cell burned, of shape (height, width) """
+        shape = (_lib.fs_ensemble_height(self._handle), _lib.fs_ensemble_width(self._handle))
+        return _array(self, _lib.fs_ensemble_burned_amounts(self._handle), ctypes.c_uint64, shape)
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("Usage: python firespread.py <landscape_file_prefix> [n_replicates] [gpu|cpu]")
+        sys.exit(1)
+
+    prefix = sys.argv[1]
+    n_replicates = int(sys.argv[2]) if len(sys.argv) > 2 else 100
+    engine = CPU if len(sys.argv) > 3 and sys.argv[3] == "cpu" else GPU
+
+    landscape = Landscape.load(prefix)
+    if engine == CPU:
+        landscape.prepare(MODEL)
+    ignition_cells = read_ignition_cells(prefix)
+    params = Params(0.0, 0.5, 0.2, 0.2, 0.2, 0.2, 0.2, 0.2, 0.2)
+
+    ensemble = Ensemble().simulate(landscape, ignition_cells, params, MODEL, 0, n_replicates, engine)
+    probabilities = ensemble.burned_amounts / ensemble.n_replicates
+    print(f"Landscape size: {landscape.width} {landscape.height}")
+    print(f"Simulations: {ensemble.n_replicates}")
+    print(f"Mean burned cells: {probabilities.sum():.2f}")
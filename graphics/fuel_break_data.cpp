@@ -0,0 +1,86 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <fstream>
+
+#include "ignition_cells.hpp"
+#include "incremental_ensemble.hpp"
+#include "landscape.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#ifndef N_REPLICATES
+#define N_REPLICATES 100
+#endif
+#define FILENAME "graphics/simdata/burned_probabilities_data.txt"
+
+// Burn probabilities after applying fuel breaks (edits of the burnable layer), re-simulating only
+// the replicates that the edits can change
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 3) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <burnable_edits.csv>" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    std::vector<BurnableEdit> edits = read_burnable_edits(argv[2]);
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    IncrementalEnsemble ensemble(
+        landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, N_REPLICATES
+    );
+    auto built = std::chrono::steady_clock::now();
+    size_t resimulated = ensemble.apply_edits(edits);
+    auto updated = std::chrono::steady_clock::now();
+
+    std::cout << "  FUEL BREAK UPDATE" << std::endl;
+    std::cout << "* Edited cells: " << edits.size() << std::endl;
+    std::cout << "* Full ensemble: " << std::chrono::duration<double>(built - start).count() << " seconds" << std::endl;
+    std::cout << "* Incremental update: " << std::chrono::duration<double>(updated - built).count() << " seconds" << std::endl;
+    std::cout << "* Re-simulated replicates: " << resimulated << " of " << N_REPLICATES << std::endl;
+
+    // Abrir el archivo de salida y crear la cadena con información
+    TRACE_SPAN("write_burned_amounts", "output");
+    const Matrix<size_t>& burned_amounts = ensemble.burned_amounts();
+    std::ofstream outputFile(FILENAME);
+    outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
+    outputFile << "Simulations: " << N_REPLICATES << std::endl;
+    // Escribir los valores de burned_amounts en el archivo
+    for (size_t i = 0; i < landscape.height; i++) {
+        for (size_t j = 0; j < landscape.width; j++) {
+            if (j != 0) {
+                outputFile << " ";
+            }
+            outputFile << burned_amounts[{j, i}];
+        }
+        outputFile << std::endl;
+    }
+    // Cerrar archivo de salida
+    outputFile.close();
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <fstream>
+
+#include <omp.h>
+
+#include "ignition_ensemble.hpp"
+#include "landscape.hpp"
+#include "memory_accounting.hpp"
+#include "memory_plan.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#define FILENAME "graphics/simdata/ignition_ensemble_data.txt"
+
+// Burn probabilities over the whole landscape with one ignition per replicate drawn from an
+// ignition density (uniform over the burnable cells if not given), see ignition_ensemble.hpp
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 3 && argc != 4) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <n_replicates> [ignition_density_file]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+    size_t n_replicates = std::stoul(argv[2]);
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+    MemoryUsage landscape_usage(MemoryComponent::LANDSCAPE, landscape.bytes());
+
+    std::vector<double> density;
+    if (argc == 4) {
+      density = read_ignition_density(argv[3], landscape.width, landscape.height);
+    }
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    // with FIRE_SPREAD_MEMORY_BUDGET=<MB>, fewer threads run if needed, and the run is refused if
+    // a single one doesn't fit
+    MemoryPlanRequest request;
+    request.width = landscape.width;
+    request.height = landscape.height;
+    request.engine = EnsembleEngine::IGNITION_ENSEMBLE;
+    request.n_threads = omp_get_max_threads();
+    request.n_replicates = n_replicates;
+    MemoryPlan plan = fit_memory_budget(request, memory_budget_from_env());
+    omp_set_num_threads(plan.request.n_threads);
+    print_memory_plan(plan, std::cout);
+
+    auto start = std::chrono::steady_clock::now();
+    IgnitionEnsemble ensemble = simulate_ignition_ensemble(
+        landscape, density, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT, n_replicates
+    );
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t total_burned = 0;
+    for (size_t size : ensemble.fire_sizes) {
+      total_burned += size;
+    }
+    std::cout << "  IGNITION ENSEMBLE" << std::endl;
+    std::cout << "* Simulations: " << n_replicates << std::endl;
+    std::cout << "* Mean fire size: " << double(total_burned) / n_replicates << " cells" << std::endl;
+    std::cout << "* Time taken: " << seconds << " seconds" << std::endl;
+
+    // Probabilities, one row of the landscape per line, followed by the fire sizes as
+    // "<min size> <max size> <fires>" in powers of two
+    TRACE_SPAN("write_ignition_ensemble", "output");
+    std::ofstream outputFile(FILENAME);
+    outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
+    outputFile << "Simulations: " << n_replicates << std::endl;
+    for (size_t i = 0; i < landscape.height; i++) {
+      for (size_t j = 0; j < landscape.width; j++) {
+        if (j != 0) {
+          outputFile << " ";
+        }
+        outputFile << ensemble.burn_probability[{j, i}];
+      }
+      outputFile << std::endl;
+    }
+    std::vector<size_t> histogram = fire_size_histogram(ensemble.fire_sizes);
+    outputFile << "Fire sizes: " << histogram.size() << std::endl;
+    for (size_t k = 0; k < histogram.size(); k++) {
+      outputFile << (size_t(1) << k) << " " << (size_t(2) << k) - 1 << " " << histogram[k] << std::endl;
+    }
+    outputFile.close();
+
+    report_memory_usage(std::cout);
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <fstream>
+
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "multi_param_spread.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#ifndef N_REPLICATES
+#define N_REPLICATES 100
+#endif
+#define FILENAME "graphics/simdata/param_sweep_data.txt"
+
+// Mean burned cells of every parameter set of a csv file, simulating all the sets of a replicate
+// in one traversal of the landscape
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 3) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <params.csv>" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+    LandscapeView view = landscape.view();
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    std::vector<SimulationParams> params = read_params_file(argv[2]);
+    if (params.empty()) {
+      throw std::runtime_error("Empty parameters file");
+    }
+
+    std::vector<double> total_burned(params.size(), 0);
+    double total_time_taken = 0;
+    bool same = true;
+    double single_time_taken = 0;
+
+    for (size_t i = 0; i < N_REPLICATES; i++) {
+      TRACE_SPAN("replicate", "simulation", "replicate", i);
+      auto start = std::chrono::steady_clock::now();
+      std::vector<Fire> fires = simulate_fire_multi_param(
+        view, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, i, UPPER_LIMIT
+      );
+      total_time_taken += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      for (size_t p = 0; p < params.size(); p++) {
+        total_burned[p] += fires[p].n_burned();
+      }
+
+      // the first replicate is also simulated one parameter set at a time, to check and compare
+      if (i == 0) {
+        start = std::chrono::steady_clock::now();
+        for (size_t p = 0; p < params.size(); p++) {
+          Fire single = simulate_fire_cpu(
+            view, ignition_cells, params[p], DISTANCE, ELEVATION_MEAN, ELEVATION_SD, i, UPPER_LIMIT
+          );
+          same = same && single == fires[p] && single.burned_ids_steps == fires[p].burned_ids_steps &&
+                 single.processed_cells == fires[p].processed_cells;
+        }
+        single_time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      }
+    }
+
+    std::cout << "  PARAMETER SWEEP (" << params.size() << " parameter sets)" << std::endl;
+    std::cout << "* Total time taken: " << total_time_taken << " seconds" << std::endl;
+    std::cout << "* Average time per replicate: " << total_time_taken / N_REPLICATES << " seconds" << std::endl;
+    std::cout << "* One parameter set at a time (first replicate): " << single_time_taken << " seconds" << std::endl;
+    std::cout << "* Matches one parameter set at a time: " << (same ? "yes" : "no") << std::endl;
+
+    TRACE_SPAN("write_param_sweep", "output");
+    std::ofstream outputFile(FILENAME);
+    outputFile << "param_set,mean_burned_cells" << std::endl;
+    for (size_t p = 0; p < params.size(); p++) {
+      outputFile << p << "," << total_burned[p] / N_REPLICATES << std::endl;
+    }
+    outputFile.close();
+
+    if (!same) {
+      throw std::runtime_error("Parameter sweep differs from the single parameter simulation");
+    }
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <fstream>
+
+#include "ignition_cells.hpp"
+#include "importance_splitting.hpp"
+#include "landscape.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#define SEED 123
+#define FILENAME "graphics/simdata/rare_burn_probabilities.txt"
+
+// Burn probabilities resolved far from the ignition cells with multilevel splitting (see
+// importance_splitting.hpp)
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 5 && argc != 6) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <n_particles> <level_spacing> <split_factor> [max_particles]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+    size_t n_particles = std::stoul(argv[2]);
+    size_t level_spacing = std::stoul(argv[3]);
+    size_t split_factor = std::stoul(argv[4]);
+    size_t max_particles = argc == 6 ? std::stoul(argv[5]) : 4 * n_particles;
+
+    // read the landscape
+    LandscapeSoA landscape(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv");
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    SplittingEstimate estimate = estimate_rare_burn_probabilities(
+        landscape, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, UPPER_LIMIT,
+        n_particles, level_spacing, split_factor, max_particles, SEED
+    );
+
+    double min_probability = 1.0;
+    for (double p : estimate.probability.elems) {
+      if (p > 0) {
+        min_probability = std::min(min_probability, p);
+      }
+    }
+
+    std::cout << "  RARE EVENT BURN PROBABILITIES" << std::endl;
+    std::cout << "* Fires per level:";
+    for (size_t n : estimate.particles_per_level) {
+      std::cout << " " << n;
+    }
+    std::cout << std::endl;
+    std::cout << "* Simulated steps: " << estimate.simulated_steps << std::endl;
+    std::cout << "* Smallest resolved probability: " << min_probability << std::endl;
+
+    TRACE_SPAN("write_burn_probabilities", "output");
+    std::ofstream outputFile(FILENAME);
+    outputFile << "Landscape size: " << landscape.width << " " << landscape.height << std::endl;
+    outputFile << "Fires: " << n_particles << std::endl;
+    for (size_t i = 0; i < landscape.height; i++) {
+      for (size_t j = 0; j < landscape.width; j++) {
+        if (j != 0) {
+          outputFile << " ";
+        }
+        outputFile << estimate.probability[{j, i}];
+      }
+      outputFile << std::endl;
+    }
+    outputFile.close();
+  } catch (std::runtime_error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
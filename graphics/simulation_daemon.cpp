@@ -0,0 +1,67 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "landscape_cache.hpp"
+#include "simulation_server.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#define DEFAULT_MEMORY_CAP_MB 2048
+
+namespace {
+
+SimulationServer* running_server = nullptr;
+
+void stop_server(int) {
+  if (running_server) {
+    running_server->stop();
+  }
+}
+
+} // namespace
+
+// Serves simulation requests on a UNIX socket until SIGINT or SIGTERM, see simulation_server.hpp
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc < 3 || argc > 5) {
+      std::cerr << "Usage: " << argv[0] << " <socket_path> <data_directory> [n_workers] [memory_cap_mb]" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // requests name landscapes relative to the data directory, nothing outside it is read or written
+    std::string data_directory = argv[2];
+    size_t n_workers = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    size_t memory_cap_mb = argc > 4 ? std::stoul(argv[4]) : DEFAULT_MEMORY_CAP_MB;
+
+    LandscapeCache cache(memory_cap_mb << 20, DISTANCE, ELEVATION_MEAN, ELEVATION_SD);
+    SimulationServer server(argv[1], data_directory, cache, UPPER_LIMIT, n_workers);
+
+    running_server = &server;
+    std::signal(SIGINT, stop_server);
+    std::signal(SIGTERM, stop_server);
+
+    std::cout << "Listening on " << argv[1] << " with " << n_workers << " workers" << std::endl;
+    server.run();
+    running_server = nullptr;
+
+    LandscapeCache::Stats stats = cache.stats();
+    std::cout << "  SIMULATION DAEMON" << std::endl;
+    std::cout << "* Landscape cache hits: " << stats.hits << std::endl;
+    std::cout << "* Landscape cache misses: " << stats.misses << std::endl;
+    std::cout << "* Landscape cache evictions: " << stats.evictions << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+
+#include "ignition_cells.hpp"
+#include "tiled_landscape.hpp"
+#include "trace.hpp"
+
+#define DISTANCE 30.0f
+#define ELEVATION_MEAN 1163.3f
+#define ELEVATION_SD 399.5f
+#define UPPER_LIMIT 0.5f
+#ifndef N_REPLICATES
+#define N_REPLICATES 10
+#endif
+#define TILE_SIZE 64
+
+// Simulates fires over an out-of-core (tiled) landscape with a bounded amount of resident memory.
+// The tile file `<landscape_file_prefix>-tiles.bin` is created on the first run, and rebuilt when
+// the landscape files change.
+int main(int argc, char* argv[]) {
+  try {
+
+    // check if the number of arguments is correct
+    if (argc != 3) {
+      std::cerr << "Usage: " << argv[0] << " <landscape_file_prefix> <ram_budget_MB>" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::string landscape_file_prefix = argv[1];
+    size_t ram_budget = std::stoul(argv[2]) << 20;
+    std::string tiles_filename = landscape_file_prefix + "-tiles.bin";
+
+    update_landscape_tiles(
+        landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv",
+        tiles_filename, TILE_SIZE
+    );
+
+    // read the ignition cells
+    IgnitionCells ignition_cells =
+        read_ignition_cells(landscape_file_prefix + "-ignition_points.csv");
+
+    SimulationParams params = {
+      0.0f, 0.5f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f
+    };
+
+    TileCache tiles(tiles_filename, ram_budget);
+    double total_time_taken = 0;
+    size_t total_burned = 0;
+    for (size_t i = 0; i < N_REPLICATES; i++) {
+      TRACE_SPAN("replicate", "simulation", "replicate", i);
+      TiledFire fire = simulate_fire_tiled(
+        tiles, ignition_cells, params, DISTANCE, ELEVATION_MEAN, ELEVATION_SD, i, UPPER_LIMIT
+      );
+      total_time_taken += fire.time_taken;
+      total_burned += fire.burned_ids.size();
+    }
+
+    std::cout << "  TILED SIMULATION PERFORMANCE DATA" << std::endl;
+    std::cout << "* Landscape size: " << tiles.width() << " " << tiles.height() << std::endl;
+    std::cout << "* Total time taken: " << total_time_taken << " seconds" << std::endl;
+    std::cout << "* Average burned cells: " << total_burned / N_REPLICATES << std::endl;
+    std::cout << "* Tile loads: " << tiles.tile_loads << ", evictions: " << tiles.tile_evictions << std::endl;
+    std::cout << "* Peak resident tiles: " << tiles.peak_resident_bytes / 1024 << " KiB (budget " << ram_budget / 1024 << " KiB)" << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  trace::flush();
+
+  return EXIT_SUCCESS;
+}
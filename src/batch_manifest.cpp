@@ -0,0 +1,44 @@
+#include "batch_manifest.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+#include "csv.hpp"
+
+BatchManifest read_batch_manifest(std::string filename) {
+
+  std::ifstream file(filename);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("Can't open batch manifest file");
+  }
+
+  BatchManifest manifest;
+
+  CSVIterator loop(file);
+  loop++; // skip first line
+
+  for (; loop != CSVIterator(); ++loop) {
+    if (loop->size() == 1 && (*loop)[0].empty()) {
+      continue; // blank line
+    }
+    if (loop->size() < 12) {
+      throw std::runtime_error("Invalid batch manifest file");
+    }
+    const CSVRow& row = *loop;
+    manifest.push_back({
+      std::string(row[0]),
+      std::string(row[1]),
+      size_t(atol(row[2].data())),
+      {
+        float(atof(row[3].data())), float(atof(row[4].data())), float(atof(row[5].data())),
+        float(atof(row[6].data())), float(atof(row[7].data())), float(atof(row[8].data())),
+        float(atof(row[9].data())), float(atof(row[10].data())), float(atof(row[11].data())),
+      },
+    });
+  }
+
+  file.close();
+
+  return manifest;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "spread_functions.cuh"
+
+/* One run of a batch: a landscape and a parameter set.
+ *
+ * A manifest is a csv file with a header line and one run per line:
+ *   landscape_prefix,output_suffix,n_replicates,independent,wind,elevation,slope,subalpine,wet,dry,fwi,aspect
+ * where the last nine columns are the `SimulationParams` in declaration order.
+ */
+struct BatchEntry {
+  std::string landscape_prefix;
+  std::string output_suffix;
+  size_t n_replicates;
+  SimulationParams params;
+};
+
+typedef std::vector<BatchEntry> BatchManifest;
+
+BatchManifest read_batch_manifest(std::string filename);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/* Blocking FIFO with a fixed capacity, used to connect the stages of a pipeline. `push` waits
+ * while the queue is full, so a fast producer can't get more than `capacity` items ahead of its
+ * consumer. After `close`, `pop` drains the remaining items and then returns std::nullopt.
+ */
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+  // Returns false (dropping `item`) if the queue was closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(item));
+    not_empty.notify_one();
+    return true;
+  }
+
+  std::optional<T> pop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [&] { return closed || !items.empty(); });
+    if (items.empty()) {
+      return std::nullopt;
+    }
+    T item = std::move(items.front());
+    items.pop_front();
+    not_full.notify_one();
+    return item;
+  }
+
+  // Removes (without waiting) up to `max_items` of the queued items for which `predicate` is true,
+  // keeping the order of the rest
+  template <typename Predicate> std::vector<T> take_if(Predicate predicate, size_t max_items) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<T> taken;
+    for (auto it = items.begin(); it != items.end() && taken.size() < max_items;) {
+      if (predicate(*it)) {
+        taken.push_back(std::move(*it));
+        it = items.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (!taken.empty()) {
+      not_full.notify_all();
+    }
+    return taken;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+
+private:
+  size_t capacity;
+  bool closed = false;
+  std::deque<T> items;
+  std::mutex mutex;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+};
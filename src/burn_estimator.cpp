@@ -0,0 +1,167 @@
+#include "burn_estimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+
+#include <omp.h>
+
+#include "memory_accounting.hpp"
+#include "numa.hpp"
+#include "reachable_region.hpp"
+#include "trace.hpp"
+
+EdgeStream parse_edge_stream(std::string name) {
+  if (name == "mc") {
+    return EdgeStream::INDEPENDENT;
+  } else if (name == "antithetic") {
+    return EdgeStream::ANTITHETIC;
+  } else if (name == "stratified") {
+    return EdgeStream::STRATIFIED;
+  }
+  throw std::runtime_error("Unknown estimator " + name + " (expected mc, antithetic or stratified)");
+}
+
+BurnProbabilityEstimate estimate_burn_probabilities(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, EdgeStream stream, size_t n_blocks, size_t block_size
+) {
+  if (stream == EdgeStream::INDEPENDENT) {
+    block_size = 1;
+  } else if (stream == EdgeStream::ANTITHETIC) {
+    block_size = 2;
+  }
+  if (n_blocks < 2 || block_size == 0 || (block_size & (block_size - 1)) != 0) {
+    throw std::runtime_error("The estimator needs at least 2 blocks of a power of two replicates");
+  }
+
+  // Only the reachable region can burn, see burned_amounts_per_cell
+  CropWindow window = reachable_window(landscape, ignition_cells);
+  LandscapeView view = window_view(landscape.view(), window);
+  std::vector<std::pair<size_t, size_t>> cropped_ignition_cells =
+      crop_ignition_cells(ignition_cells, window);
+  size_t n_cells = window.width * window.height;
+
+  // The layers of the window (copied straight from the landscape) and their derived terms (computed
+  // once for all the replicates) are placed as configured by the environment, see numa.hpp
+  NumaConfig numa = numa_config_from_env();
+  NumaTopology topology = detect_numa_topology();
+  NumaLandscape placed(view, topology, numa);
+  std::vector<std::optional<DerivedLayers>> derived(placed.n_replicas());
+  auto compute_derived = [&](int node) {
+    derived[node].emplace(
+        DerivedLayers::compute(placed.view(node), distance, elevation_mean, elevation_sd)
+    );
+  };
+  if (placed.n_replicas() > 1) {
+    run_on_each_node(topology, compute_derived);
+  } else {
+    compute_derived(0);
+  }
+  MemoryUsage placed_usage(MemoryComponent::LANDSCAPE, placed.bytes());
+  MemoryUsage derived_usage(MemoryComponent::DERIVED_LAYERS, derived.size() * derived[0]->bytes());
+
+  // Per thread sums over blocks of the block means and of their squares, allocated by each thread
+  // so that they are on its node
+  int n_threads = omp_get_max_threads();
+  std::vector<HugePageVector<double>> sums(n_threads);
+  std::vector<HugePageVector<double>> sums_squares(n_threads);
+
+  #pragma omp parallel
+  {
+    int thread = omp_get_thread_num();
+    // Unpinned again when the parallel region ends
+    std::optional<ThreadPin> pin;
+    if (numa.pin_threads) {
+      pin.emplace(topology, thread);
+    }
+    int node = pin ? pin->node() : current_numa_node(topology);
+    LandscapeView local_view = placed.view(node);
+    DerivedView derived_view = derived[placed.replica_of(node)]->view();
+
+    HugePageAllocator<double> allocator(numa.huge_pages);
+    HugePageVector<double>& sum = sums[thread] = HugePageVector<double>(n_cells, 0.0, allocator);
+    HugePageVector<double>& sum_squares = sums_squares[thread] =
+        HugePageVector<double>(n_cells, 0.0, allocator);
+
+    MemoryUsage sums_usage(MemoryComponent::ACCUMULATORS, 2 * n_cells * sizeof(double));
+
+    std::vector<uint32_t> counts(n_cells, 0);
+    std::vector<size_t> touched;
+    CpuFireState state = start_fire_cpu(local_view, cropped_ignition_cells, 0);
+    MemoryUsage state_usage(MemoryComponent::FIRE_BUFFERS);
+
+    #pragma omp for schedule(dynamic)
+    for (size_t b = 0; b < n_blocks; b++) {
+      TRACE_SPAN("estimator_block", "simulation", "block", b);
+      for (size_t r = 0; r < block_size; r++) {
+        state.stream = { stream, uint32_t(r), uint32_t(block_size) };
+        restart_fire_cpu(state, local_view, cropped_ignition_cells, replicate_seed(b));
+        while (advance_fire_step_cpu(state, local_view, derived_view, params, upper_limit)) {
+        }
+        for (size_t idx : state.burned_ids) {
+          if (counts[idx]++ == 0) {
+            touched.push_back(idx);
+          }
+        }
+      }
+      for (size_t idx : touched) {
+        double mean = double(counts[idx]) / block_size;
+        sum[idx] += mean;
+        sum_squares[idx] += mean * mean;
+        counts[idx] = 0;
+      }
+      state_usage.set(
+          state.capacity_bytes() + counts.capacity() * sizeof(uint32_t) +
+          touched.capacity() * sizeof(size_t)
+      );
+      touched.clear();
+    }
+  }
+
+  // The sums of the threads that ran, plus the cropped results
+  size_t n_sums = std::count_if(sums.begin(), sums.end(), [](const auto& sum) {
+    return !sum.empty();
+  });
+  MemoryUsage results_usage(
+      MemoryComponent::ACCUMULATORS, (2 * n_sums + 2) * n_cells * sizeof(double)
+  );
+  Matrix<double> cropped_probability(window.width, window.height);
+  Matrix<double> cropped_error(window.width, window.height);
+  double mc_variance = 0.0;
+  double estimator_variance = 0.0;
+  size_t n_replicates = n_blocks * block_size;
+
+  for (size_t idx = 0; idx < n_cells; idx++) {
+    double sum = 0.0, sum_squares = 0.0;
+    for (int t = 0; t < n_threads; t++) {
+      if (!sums[t].empty()) { // empty if the team had fewer threads
+        sum += sums[t][idx];
+        sum_squares += sums_squares[t][idx];
+      }
+    }
+    double p = sum / n_blocks;
+    // Unbiased sample variance of the block means, divided by the number of blocks
+    double block_variance = std::max(0.0, (sum_squares - n_blocks * p * p) / (n_blocks - 1));
+    double variance = block_variance / n_blocks;
+
+    cropped_probability.elems[idx] = p;
+    cropped_error.elems[idx] = std::sqrt(variance);
+    mc_variance += p * (1.0 - p) / n_replicates;
+    estimator_variance += variance;
+  }
+
+  BurnProbabilityEstimate estimate = {
+    Matrix<double>(landscape.width, landscape.height),
+    Matrix<double>(landscape.width, landscape.height),
+    n_replicates,
+    estimator_variance > 0.0 ? mc_variance / estimator_variance : 1.0,
+  };
+  size_t estimate_bytes = 2 * landscape.width * landscape.height * sizeof(double);
+  results_usage.set((2 * n_sums + 2) * n_cells * sizeof(double) + estimate_bytes);
+  add_cropped_amounts(estimate.probability, cropped_probability, window);
+  add_cropped_amounts(estimate.standard_error, cropped_error, window);
+  return estimate;
+}
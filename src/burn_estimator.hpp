@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+#include "matrix.hpp"
+#include "spread_functions.cuh"
+#include "spread_functions_cpu.hpp"
+
+/* Burn probabilities with variance reduction and standard errors.
+ *
+ * Replicates are grouped in `n_blocks` independent blocks of `block_size` replicates whose draws
+ * are coupled as described by `EdgeStream` (antithetic pairs, or a Latin hypercube that stratifies
+ * the draws of every edge across the block). Each block gives an unbiased estimate of the burn
+ * probability of every cell; the estimate is their mean and the standard error comes from their
+ * spread across blocks, which is valid because blocks are independent. With INDEPENDENT streams
+ * every block is one plain Monte Carlo replicate.
+ */
+
+struct BurnProbabilityEstimate {
+  Matrix<double> probability;
+  Matrix<double> standard_error;
+  size_t n_replicates;
+  // Variance of plain Monte Carlo with the same number of replicates divided by the variance of
+  // this estimator, summed over the cells: how many times more plain replicates would be needed
+  double speedup;
+};
+
+BurnProbabilityEstimate estimate_burn_probabilities(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, EdgeStream stream, size_t n_blocks, size_t block_size
+);
+
+// "mc", "antithetic" or "stratified"
+EdgeStream parse_edge_stream(std::string name);
@@ -0,0 +1,166 @@
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+namespace {
+
+const uint64_t CHECKPOINT_MAGIC = 0x3154504b43524946ULL; // "FIRCKPT1"
+
+struct CheckpointHeader {
+  uint64_t magic;
+  uint64_t key;
+  uint64_t n_cells;
+  uint64_t next_replicate;
+  float max_metric;
+  float total_time_taken;
+};
+
+bool write_all(int fd, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, bytes, size);
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+void write_checkpoint(const std::string& filename, uint64_t key, const EnsembleCheckpoint& state) {
+  CheckpointHeader header = {
+    CHECKPOINT_MAGIC, key, state.burned_amounts.size(), state.next_replicate, state.max_metric,
+    state.total_time_taken
+  };
+
+  // Synced before the rename, so that the file renamed over the previous checkpoint is complete
+  std::string temporary_name = filename + ".tmp" + std::to_string(getpid());
+  int fd = open(temporary_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written = fd >= 0 && write_all(fd, &header, sizeof(header)) &&
+                 write_all(
+                     fd, state.burned_amounts.data(), state.burned_amounts.size() * sizeof(size_t)
+                 ) &&
+                 fsync(fd) == 0;
+  if (fd >= 0 && close(fd) != 0) {
+    written = false;
+  }
+  if (!written || rename(temporary_name.c_str(), filename.c_str()) != 0) {
+    std::remove(temporary_name.c_str());
+    throw std::runtime_error("Can't write checkpoint " + filename);
+  }
+}
+
+} // namespace
+
+std::optional<EnsembleCheckpoint> read_checkpoint(
+    const std::string& filename, uint64_t key, size_t n_cells
+) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  CheckpointHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != CHECKPOINT_MAGIC) {
+    throw std::runtime_error("Invalid checkpoint " + filename);
+  }
+  if (header.key != key || header.n_cells != n_cells) {
+    throw std::runtime_error(
+        "Checkpoint " + filename + " belongs to another landscape, configuration or replicate range"
+    );
+  }
+
+  EnsembleCheckpoint state = {
+    header.next_replicate, header.max_metric, header.total_time_taken,
+    std::vector<size_t>(n_cells)
+  };
+  if (!file.read(reinterpret_cast<char*>(state.burned_amounts.data()), n_cells * sizeof(size_t))) {
+    throw std::runtime_error("Truncated checkpoint " + filename);
+  }
+  return state;
+}
+
+CheckpointWriter::CheckpointWriter(std::string filename, uint64_t key, double interval_seconds)
+    : filename(filename), key(key), interval(interval_seconds),
+      last_checkpoint(std::chrono::steady_clock::now()),
+      writer(&CheckpointWriter::write_loop, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+  try {
+    close();
+  } catch (std::runtime_error&) {
+    // Errors are only reported by an explicit close
+  }
+}
+
+void CheckpointWriter::offer(
+    size_t next_replicate, float max_metric, float total_time_taken,
+    const std::vector<size_t>& burned_amounts
+) {
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_checkpoint < interval) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (pending) {
+    return; // the previous checkpoint is still being written, try again after the next replicate
+  }
+  TRACE_SPAN("stage_checkpoint", "output", "replicate", next_replicate);
+  staged.next_replicate = next_replicate;
+  staged.max_metric = max_metric;
+  staged.total_time_taken = total_time_taken;
+  staged.burned_amounts.assign(burned_amounts.begin(), burned_amounts.end());
+  pending = true;
+  last_checkpoint = now;
+  wake.notify_one();
+}
+
+void CheckpointWriter::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+    wake.notify_one();
+  }
+  if (writer.joinable()) {
+    writer.join();
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+}
+
+void CheckpointWriter::write_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return pending || closing; });
+    if (!pending) {
+      return;
+    }
+
+    // `staged` is not touched by `offer` while pending, so it is written without the lock
+    lock.unlock();
+    std::string failure;
+    try {
+      TRACE_SPAN("write_checkpoint", "output", "replicate", staged.next_replicate);
+      write_checkpoint(filename, key, staged);
+    } catch (const std::runtime_error& e) {
+      failure = e.what();
+    }
+    lock.lock();
+
+    if (!failure.empty()) {
+      error = failure;
+    }
+    pending = false;
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Checkpoints of a long ensemble of replicates, see `burned_amounts_per_cell`.
+ *
+ * A checkpoint holds the burned amounts accumulated so far, the next replicate to simulate and the
+ * performance totals. Replicate i is always simulated with the seed of i, so the next replicate is
+ * also the position in the random streams, and an ensemble resumed from a checkpoint ends with
+ * exactly the amounts of an uninterrupted run.
+ */
+struct EnsembleCheckpoint {
+  size_t next_replicate;
+  float max_metric;
+  float total_time_taken;
+  std::vector<size_t> burned_amounts;
+};
+
+struct CheckpointOptions {
+  std::string filename;
+  // Minimum time between two checkpoints
+  double interval_seconds = 60;
+  // Continue from `filename` if it exists
+  bool resume = false;
+};
+
+/* Reads the checkpoint in `filename`. Returns nothing if there is no such file, throws
+ * std::runtime_error if it is damaged or belongs to another ensemble (`key` or `n_cells` differ).
+ */
+std::optional<EnsembleCheckpoint> read_checkpoint(
+    const std::string& filename, uint64_t key, size_t n_cells
+);
+
+/* Writes checkpoints on a background thread. Each one is written to a temporary file, synced and
+ * renamed over `filename`, so a process killed at any point leaves the previous checkpoint intact.
+ *
+ * `offer` is called after every replicate. It only checks the clock, unless `interval_seconds`
+ * have passed since the last checkpoint and the writer is idle, in which case it copies the state
+ * for the writer.
+ */
+class CheckpointWriter {
+public:
+  CheckpointWriter(std::string filename, uint64_t key, double interval_seconds);
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  ~CheckpointWriter();
+
+  void offer(
+      size_t next_replicate, float max_metric, float total_time_taken,
+      const std::vector<size_t>& burned_amounts
+  );
+
+  // Waits for the checkpoint being written. Throws if a checkpoint couldn't be written.
+  void close();
+
+private:
+  void write_loop();
+
+  std::string filename;
+  uint64_t key;
+  std::chrono::duration<double> interval;
+  std::chrono::steady_clock::time_point last_checkpoint;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  EnsembleCheckpoint staged;
+  bool pending = false;
+  bool closing = false;
+  std::string error;
+  std::thread writer;
+};
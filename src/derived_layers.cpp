@@ -0,0 +1,204 @@
+#include "derived_layers.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+namespace {
+
+constexpr uint64_t DERIVED_MAGIC = 0x3156494544524946; // "FIRDERV1"
+
+struct DerivedHeader {
+  uint64_t magic;
+  uint64_t landscape_hash;
+  uint64_t width, height;
+  float distance, elevation_mean, elevation_sd, padding;
+};
+
+// Byte offsets of each layer, every layer starts on a cache line
+struct DerivedLayout {
+  size_t elevation_term, slope_term, wind_term, burnable_neighbors, total;
+};
+
+size_t align_up(size_t offset) {
+  return (offset + 63) & ~size_t(63);
+}
+
+DerivedLayout derived_layout(size_t width, size_t height) {
+  size_t n_cells = width * height;
+  DerivedLayout layout;
+  layout.elevation_term = align_up(sizeof(DerivedHeader));
+  layout.slope_term = align_up(layout.elevation_term + n_cells * sizeof(float));
+  layout.wind_term = align_up(layout.slope_term + n_cells * N_NEIGHBORS * sizeof(float));
+  layout.burnable_neighbors = align_up(layout.wind_term + n_cells * N_NEIGHBORS * sizeof(float));
+  layout.total = layout.burnable_neighbors + n_cells * sizeof(uint8_t);
+  return layout;
+}
+
+void fill_derived_layers(
+    char* base, const LandscapeView& landscape, const DerivedLayout& layout, float distance,
+    float elevation_mean, float elevation_sd
+) {
+  TRACE_SPAN("compute_derived_layers", "setup");
+  float* elevation_term = reinterpret_cast<float*>(base + layout.elevation_term);
+  float* slope_term = reinterpret_cast<float*>(base + layout.slope_term);
+  float* wind_term = reinterpret_cast<float*>(base + layout.wind_term);
+  uint8_t* burnable_neighbors = reinterpret_cast<uint8_t*>(base + layout.burnable_neighbors);
+
+  int width = landscape.width;
+  int height = landscape.height;
+
+  // Same expressions as `spread_probability_cpu`, so the engine gives exactly the same fires
+  #pragma omp parallel for schedule(static)
+  for (int j = 0; j < height; j++) {
+    for (int i = 0; i < width; i++) {
+      size_t cell = utils::INDEX(i, j, width);
+      float elevation = landscape.elevation[cell];
+      elevation_term[cell] = (elevation - elevation_mean) / elevation_sd;
+
+      uint8_t mask = 0;
+      for (int n = 0; n < N_NEIGHBORS; n++) {
+        int ni = i + MOVES[n][0];
+        int nj = j + MOVES[n][1];
+        size_t edge = cell * N_NEIGHBORS + n;
+        if (ni < 0 || nj < 0 || ni >= width || nj >= height) {
+          slope_term[edge] = 0;
+          wind_term[edge] = 0;
+          continue;
+        }
+        size_t neighbor = utils::INDEX(ni, nj, width);
+        slope_term[edge] =
+            std::sin(std::atan((landscape.elevation[neighbor] - elevation) / distance));
+        wind_term[edge] = std::cos(ANGLES[n] - landscape.wind_dir[cell]);
+        if (landscape.burnable[neighbor]) {
+          mask |= 1 << n;
+        }
+      }
+      burnable_neighbors[cell] = mask;
+    }
+  }
+}
+
+} // namespace
+
+size_t DerivedLayers::bytes_for(size_t width, size_t height) {
+  return derived_layout(width, height).total;
+}
+
+DerivedLayers::DerivedLayers(void* data, size_t size, bool was_computed)
+    : data(data), size(size), was_computed(was_computed) {}
+
+DerivedLayers::DerivedLayers(DerivedLayers&& other)
+    : data(other.data), size(other.size), was_computed(other.was_computed) {
+  other.data = nullptr;
+}
+
+DerivedLayers::~DerivedLayers() {
+  if (data) {
+    munmap(data, size);
+  }
+}
+
+DerivedLayers DerivedLayers::compute(
+    const LandscapeView& landscape, float distance, float elevation_mean, float elevation_sd
+) {
+  return compute(landscape, 0, distance, elevation_mean, elevation_sd);
+}
+
+DerivedLayers DerivedLayers::compute(
+    const LandscapeView& landscape, uint64_t hash, float distance, float elevation_mean,
+    float elevation_sd
+) {
+  require_contiguous(landscape, "The derived layers");
+  DerivedLayout layout = derived_layout(landscape.width, landscape.height);
+  void* data =
+      mmap(nullptr, layout.total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Can't allocate the derived layers");
+  }
+  DerivedLayers layers(data, layout.total, true);
+
+  char* base = static_cast<char*>(data);
+  DerivedHeader header = {
+    DERIVED_MAGIC, hash, landscape.width, landscape.height, distance, elevation_mean, elevation_sd, 0
+  };
+  std::memcpy(base, &header, sizeof(header));
+  fill_derived_layers(base, landscape, layout, distance, elevation_mean, elevation_sd);
+  return layers;
+}
+
+DerivedLayers DerivedLayers::open_or_build(
+    const LandscapeView& landscape, const std::string& filename, float distance,
+    float elevation_mean, float elevation_sd
+) {
+  uint64_t hash = landscape_hash(landscape);
+  DerivedLayout layout = derived_layout(landscape.width, landscape.height);
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    TRACE_SPAN("open_derived_layers", "io");
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) == layout.total) {
+      data = mmap(nullptr, layout.total, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data != MAP_FAILED) {
+      DerivedLayers layers(data, layout.total, false);
+      const DerivedHeader* header = static_cast<const DerivedHeader*>(data);
+      if (header->magic == DERIVED_MAGIC && header->landscape_hash == hash &&
+          header->width == landscape.width && header->height == landscape.height &&
+          header->distance == distance && header->elevation_mean == elevation_mean &&
+          header->elevation_sd == elevation_sd) {
+        return layers;
+      }
+    }
+    // Stale or invalid sidecar, computed and written again
+  }
+
+  DerivedLayers layers = compute(landscape, hash, distance, elevation_mean, elevation_sd);
+
+  // Written to a temporary file and renamed, so concurrent runs never map a partial sidecar. Every
+  // writer has its own temporary file (threads of one process too), and as the sidecars of the same
+  // landscape are identical, whichever rename comes last wins.
+  TRACE_SPAN("write_derived_layers", "io");
+  std::string temporary_name = filename + ".tmpXXXXXX";
+  int temporary_fd = mkstemp(temporary_name.data());
+  if (temporary_fd < 0) {
+    throw std::runtime_error("Can't write derived layers file " + filename);
+  }
+  fchmod(temporary_fd, 0644);
+  close(temporary_fd);
+  std::ofstream file(temporary_name, std::ios::binary);
+  file.write(static_cast<const char*>(layers.data), layout.total);
+  file.close();
+  if (!file || rename(temporary_name.c_str(), filename.c_str()) != 0) {
+    std::remove(temporary_name.c_str());
+    throw std::runtime_error("Can't write derived layers file " + filename);
+  }
+  return layers;
+}
+
+DerivedView DerivedLayers::view() const {
+  const char* base = static_cast<const char*>(data);
+  const DerivedHeader* header = reinterpret_cast<const DerivedHeader*>(base);
+  DerivedLayout layout = derived_layout(header->width, header->height);
+  return {
+    header->width,
+    header->height,
+    reinterpret_cast<const float*>(base + layout.elevation_term),
+    reinterpret_cast<const float*>(base + layout.slope_term),
+    reinterpret_cast<const float*>(base + layout.wind_term),
+    reinterpret_cast<const uint8_t*>(base + layout.burnable_neighbors),
+  };
+}
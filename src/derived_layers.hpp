@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "landscape.hpp"
+
+/* Terms of the spread model that only depend on the landscape and the model constants, computed
+ * once instead of for every visit of an edge:
+ * - elevation_term[cell]: (elevation - elevation_mean) / elevation_sd
+ * - slope_term[cell * N_NEIGHBORS + n]: sin(atan(dz / distance)) from `cell` to its neighbor in
+ *   direction n
+ * - wind_term[cell * N_NEIGHBORS + n]: cos(ANGLES[n] - wind direction of `cell`)
+ * - burnable_neighbors[cell]: bit n set if the neighbor in direction n exists and is burnable
+ * Terms of edges leaving the landscape are 0. The parameters are combined with them at run time
+ * (see `spread_probability_cpu`).
+ */
+struct DerivedView {
+  size_t width, height;
+
+  const float* elevation_term;
+  const float* slope_term;
+  const float* wind_term;
+  const uint8_t* burnable_neighbors;
+};
+
+/* Derived layers of a landscape, either computed in memory or mapped from a sidecar file.
+ *
+ * The sidecar stores the hash of the landscape (`landscape_hash`) and the model constants it was
+ * computed with; `open_or_build` maps it read-only when both match and otherwise computes the
+ * layers again and replaces it, so later runs on the same landscape start warm.
+ */
+class DerivedLayers {
+public:
+  // Computes the layers in memory (e.g. for a cropped landscape, which is not worth persisting)
+  static DerivedLayers compute(
+      const LandscapeView& landscape, float distance, float elevation_mean, float elevation_sd
+  );
+
+  static DerivedLayers open_or_build(
+      const LandscapeView& landscape, const std::string& filename, float distance,
+      float elevation_mean, float elevation_sd
+  );
+
+  DerivedLayers(DerivedLayers&& other);
+  DerivedLayers(const DerivedLayers&) = delete;
+  DerivedLayers& operator=(const DerivedLayers&) = delete;
+  ~DerivedLayers();
+
+  DerivedView view() const;
+
+  // Bytes taken by the layers
+  size_t bytes() const {
+    return size;
+  }
+
+  // Bytes taken by the layers of a landscape of the given size
+  static size_t bytes_for(size_t width, size_t height);
+
+  // Whether the layers were computed by this object (false when read from a valid sidecar)
+  bool computed() const {
+    return was_computed;
+  }
+
+private:
+  DerivedLayers(void* data, size_t size, bool was_computed);
+
+  static DerivedLayers compute(
+      const LandscapeView& landscape, uint64_t landscape_hash, float distance,
+      float elevation_mean, float elevation_sd
+  );
+
+  void* data;
+  size_t size;
+  bool was_computed;
+};
@@ -0,0 +1,364 @@
+#include "distributed_spread.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "csv.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+////////////////////////////////// TRANSPORT //////////////////////////////
+
+std::vector<uint64_t> Transport::exchange(int peer, const std::vector<uint64_t>& message) {
+  if (rank() < peer) {
+    send(peer, message);
+    return receive(peer);
+  }
+  std::vector<uint64_t> received = receive(peer);
+  send(peer, message);
+  return received;
+}
+
+uint64_t Transport::allreduce_sum(uint64_t value) {
+  if (rank() == 0) {
+    for (int r = 1; r < size(); r++) {
+      value += receive(r)[0];
+    }
+    for (int r = 1; r < size(); r++) {
+      send(r, { value });
+    }
+    return value;
+  }
+  send(0, { value });
+  return receive(0)[0];
+}
+
+std::vector<std::vector<int>> SocketTransport::local_mesh(int n_ranks) {
+  std::vector<std::vector<int>> mesh(n_ranks, std::vector<int>(n_ranks, -1));
+  for (int a = 0; a < n_ranks; a++) {
+    for (int b = a + 1; b < n_ranks; b++) {
+      int fds[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        throw std::runtime_error("Can't create socket pair");
+      }
+      mesh[a][b] = fds[0];
+      mesh[b][a] = fds[1];
+    }
+  }
+  return mesh;
+}
+
+SocketTransport SocketTransport::from_local_mesh(const std::vector<std::vector<int>>& mesh, int rank) {
+  for (size_t r = 0; r < mesh.size(); r++) {
+    if (int(r) == rank) {
+      continue;
+    }
+    for (int fd : mesh[r]) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+  return SocketTransport(rank, mesh[rank]);
+}
+
+SocketTransport::SocketTransport(int rank, std::vector<int> peer_fds)
+    : my_rank(rank), peer_fds(peer_fds) {}
+
+SocketTransport::SocketTransport(SocketTransport&& other)
+    : my_rank(other.my_rank), peer_fds(std::move(other.peer_fds)) {
+  other.peer_fds.clear();
+}
+
+SocketTransport::~SocketTransport() {
+  for (int fd : peer_fds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+int SocketTransport::rank() const {
+  return my_rank;
+}
+
+int SocketTransport::size() const {
+  return peer_fds.size();
+}
+
+namespace {
+
+void write_all(int fd, const void* data, size_t n) {
+  const char* ptr = static_cast<const char*>(data);
+  while (n > 0) {
+    ssize_t written = write(fd, ptr, n);
+    if (written <= 0) {
+      throw std::runtime_error("Can't send halo message");
+    }
+    ptr += written;
+    n -= written;
+  }
+}
+
+void read_all(int fd, void* data, size_t n) {
+  char* ptr = static_cast<char*>(data);
+  while (n > 0) {
+    ssize_t got = read(fd, ptr, n);
+    if (got <= 0) {
+      throw std::runtime_error("Can't receive halo message");
+    }
+    ptr += got;
+    n -= got;
+  }
+}
+
+} // namespace
+
+void SocketTransport::send(int to, const std::vector<uint64_t>& message) {
+  uint64_t n = message.size();
+  write_all(peer_fds[to], &n, sizeof(n));
+  write_all(peer_fds[to], message.data(), n * sizeof(uint64_t));
+}
+
+std::vector<uint64_t> SocketTransport::receive(int from) {
+  uint64_t n;
+  read_all(peer_fds[from], &n, sizeof(n));
+  std::vector<uint64_t> message(n);
+  read_all(peer_fds[from], message.data(), n * sizeof(uint64_t));
+  return message;
+}
+
+////////////////////////////////// STRIPS //////////////////////////////
+
+std::pair<size_t, size_t> strip_rows(size_t height, int rank, int n_ranks) {
+  return { height * rank / n_ranks, height * (rank + 1) / n_ranks };
+}
+
+LandscapeStrip load_landscape_strip(
+    std::string metadata_filename, std::string data_filename, int rank, int n_ranks
+) {
+  TRACE_SPAN("load_landscape_strip", "io");
+
+  std::ifstream metadata_file(metadata_filename);
+  if (!metadata_file.is_open()) {
+    throw std::runtime_error("Can't open metadata file");
+  }
+  CSVIterator metadata_csv(metadata_file);
+  ++metadata_csv;
+  if (metadata_csv == CSVIterator() || (*metadata_csv).size() < 2) {
+    throw std::runtime_error("Invalid metadata file");
+  }
+  size_t width = atoi((*metadata_csv)[0].data());
+  size_t height = atoi((*metadata_csv)[1].data());
+  metadata_file.close();
+
+  if (height < size_t(n_ranks)) {
+    throw std::runtime_error("Landscape has fewer rows than processes");
+  }
+
+  auto [first_row, last_row] = strip_rows(height, rank, n_ranks);
+  size_t halo_first_row = first_row > 0 ? first_row - 1 : 0;
+  size_t halo_last_row = std::min(last_row + 1, height);
+
+  LandscapeStrip strip = {
+    width, height, first_row, last_row, halo_first_row,
+    LandscapeSoA(width, halo_last_row - halo_first_row)
+  };
+  LandscapeSoA& layers = strip.layers;
+
+  std::ifstream landscape_file(data_filename);
+  if (!landscape_file.is_open()) {
+    throw std::runtime_error("Can't open landscape file");
+  }
+  CSVIterator loop_csv(landscape_file);
+  ++loop_csv;
+
+  for (size_t j = 0; j < halo_last_row; j++) {
+    for (size_t i = 0; i < width; i++, ++loop_csv) {
+      if (loop_csv == CSVIterator() || (*loop_csv).size() < 8) {
+        throw std::runtime_error("Invalid landscape file");
+      }
+      if (j < halo_first_row) {
+        continue;
+      }
+      size_t idx = (j - halo_first_row) * width + i;
+      if (atoi((*loop_csv)[0].data()) == 1) {
+        layers.vegetation_type[idx] = SUBALPINE;
+      } else if (atoi((*loop_csv)[1].data()) == 1) {
+        layers.vegetation_type[idx] = WET;
+      } else if (atoi((*loop_csv)[2].data()) == 1) {
+        layers.vegetation_type[idx] = DRY;
+      } else {
+        layers.vegetation_type[idx] = MATORRAL;
+      }
+      layers.fwi[idx] = atof((*loop_csv)[3].data());
+      layers.aspect[idx] = atof((*loop_csv)[4].data());
+      layers.wind_dir[idx] = atof((*loop_csv)[5].data());
+      layers.elevation[idx] = atof((*loop_csv)[6].data());
+      layers.burnable[idx] = atoi((*loop_csv)[7].data());
+    }
+  }
+
+  landscape_file.close();
+  return strip;
+}
+
+////////////////////////////////// SIMULATION //////////////////////////////
+
+namespace {
+
+// Rank owning global row `row`
+int row_owner(size_t row, size_t height, int n_ranks) {
+  int owner = row * n_ranks / height;
+  // strip_rows rounds down, so the estimate can be one strip too far
+  while (strip_rows(height, owner, n_ranks).first > row) {
+    owner--;
+  }
+  while (strip_rows(height, owner, n_ranks).second <= row) {
+    owner++;
+  }
+  return owner;
+}
+
+} // namespace
+
+Fire simulate_fire_distributed(
+    Transport& transport, const LandscapeStrip& strip,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, int n_replicate, float upper_limit
+) {
+  auto start = std::chrono::steady_clock::now();
+
+  const int rank = transport.rank();
+  const int n_ranks = transport.size();
+  const size_t width = strip.width;
+  const size_t height = strip.height;
+  const size_t offset = strip.halo_first_row * width; // global index of local index 0
+  const uint64_t seed = replicate_seed(n_replicate);
+  LandscapeView landscape = strip.layers.view();
+
+  auto owned = [&](size_t row) { return row >= strip.first_row && row < strip.last_row; };
+
+  // Burn state of the stored rows, only the owned ones are authoritative
+  std::vector<uint8_t> burned(landscape.width * landscape.height, 0);
+  // Global indices of the owned cells burned at each step
+  std::vector<std::vector<uint64_t>> steps(1);
+
+  for (auto [x, y] : ignition_cells) {
+    size_t global = utils::INDEX(x, y, width);
+    if (owned(y) && !burned[global - offset]) {
+      burned[global - offset] = 1;
+      steps[0].push_back(global);
+    }
+  }
+
+  unsigned int processed_cells = 0;
+  int up = rank > 0 ? rank - 1 : -1;
+  int down = rank + 1 < n_ranks ? rank + 1 : -1;
+
+  while (true) {
+    TRACE_SPAN("spread_step", "simulation", "step", steps.size() - 1);
+    const std::vector<uint64_t>& frontier = steps.back();
+    std::vector<uint64_t> next;
+    // Ignitions of cells owned by other ranks, indexed by rank
+    std::vector<std::vector<uint64_t>> outgoing(n_ranks);
+
+    for (uint64_t burning : frontier) {
+      int i = burning % width;
+      int j = burning / width;
+
+      for (int n = 0; n < N_NEIGHBORS; n++) {
+        int ni = i + MOVES[n][0];
+        int nj = j + MOVES[n][1];
+        if (ni < 0 || nj < 0 || ni >= int(width) || nj >= int(height)) {
+          continue;
+        }
+        processed_cells++;
+
+        size_t neighbor = utils::INDEX(ni, nj, width);
+        bool is_owned = owned(nj);
+        if ((is_owned && burned[neighbor - offset]) || !landscape.burnable[neighbor - offset]) {
+          continue;
+        }
+
+        float prob = spread_probability_cpu(
+            landscape, burning - offset, neighbor - offset, n, params, distance, elevation_mean,
+            elevation_sd, upper_limit
+        );
+        if (edge_uniform(seed, burning, n) < prob) {
+          if (is_owned) {
+            burned[neighbor - offset] = 1;
+            next.push_back(neighbor);
+          } else {
+            outgoing[row_owner(nj, height, n_ranks)].push_back(neighbor);
+          }
+        }
+      }
+    }
+
+    // Halo exchange: a strip only borders the strips right above and below it
+    for (int peer : { up, down }) {
+      if (peer < 0) {
+        continue;
+      }
+      for (uint64_t neighbor : transport.exchange(peer, outgoing[peer])) {
+        if (!burned[neighbor - offset]) {
+          burned[neighbor - offset] = 1;
+          next.push_back(neighbor);
+        }
+      }
+    }
+
+    if (transport.allreduce_sum(next.size()) == 0) {
+      break;
+    }
+    steps.push_back(std::move(next));
+  }
+
+  processed_cells = transport.allreduce_sum(processed_cells);
+  double time_taken =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Gather on rank 0: every rank sends the size of each of its steps followed by the cells
+  TRACE_SPAN("gather_fire", "results");
+  if (rank != 0) {
+    std::vector<uint64_t> message;
+    for (const auto& step : steps) {
+      message.push_back(step.size());
+    }
+    for (const auto& step : steps) {
+      message.insert(message.end(), step.begin(), step.end());
+    }
+    transport.send(0, message);
+    return { width, height, processed_cells, time_taken, {}, {}, {} };
+  }
+
+  std::vector<std::vector<uint64_t>> all_steps = steps;
+  for (int r = 1; r < n_ranks; r++) {
+    std::vector<uint64_t> message = transport.receive(r);
+    size_t pos = all_steps.size();
+    for (size_t s = 0; s < all_steps.size(); s++) {
+      all_steps[s].insert(
+          all_steps[s].end(), message.begin() + pos, message.begin() + pos + message[s]
+      );
+      pos += message[s];
+    }
+  }
+
+  Fire fire = empty_fire(width, height);
+  fire.processed_cells = processed_cells;
+  fire.time_taken = time_taken;
+  for (auto& step : all_steps) {
+    std::sort(step.begin(), step.end());
+    for (uint64_t idx : step) {
+      fire.add_burned(idx);
+    }
+    fire.burned_ids_steps.push_back(fire.n_burned());
+  }
+  return fire;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fires.hpp"
+#include "landscape.hpp"
+#include "spread_functions.cuh"
+
+/* Domain-decomposed fire spread across processes.
+ *
+ * The landscape is split in horizontal strips, one per process. Each process only loads its own
+ * rows plus one halo row above and below (needed to evaluate the spread probability towards the
+ * neighbouring strip), advances the part of the frontier that it owns, and at every step sends
+ * the ignitions that cross a strip boundary to the owner of the target cell as a halo message.
+ *
+ * Random draws are the counter-based ones of `spread_functions_cpu.hpp` keyed by the global cell
+ * index, so the burned cells of every step are the same as in `simulate_fire_cpu`.
+ */
+
+// Message passing between the processes of a distributed run. Implementations only need
+// point-to-point send/receive of vectors of integers; collectives are built on top of them.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  virtual int rank() const = 0;
+  virtual int size() const = 0;
+  virtual void send(int to, const std::vector<uint64_t>& message) = 0;
+  virtual std::vector<uint64_t> receive(int from) = 0;
+
+  // Sends `message` to `peer` and returns what `peer` sent. The lower rank sends first, so two
+  // processes exchanging large messages never wait on each other's full buffers.
+  std::vector<uint64_t> exchange(int peer, const std::vector<uint64_t>& message);
+
+  uint64_t allreduce_sum(uint64_t value);
+};
+
+// Transport over connected stream sockets, one per pair of processes
+class SocketTransport : public Transport {
+public:
+  // Creates a socketpair between every pair of `n_ranks` local processes. Must be called before
+  // forking; every process then builds its transport with `from_local_mesh`.
+  static std::vector<std::vector<int>> local_mesh(int n_ranks);
+
+  // Keeps the sockets of `rank` and closes the ones that belong to the other processes
+  static SocketTransport from_local_mesh(const std::vector<std::vector<int>>& mesh, int rank);
+
+  // `peer_fds[r]` is a socket connected to rank r (ignored for r == rank)
+  SocketTransport(int rank, std::vector<int> peer_fds);
+  SocketTransport(SocketTransport&& other);
+  SocketTransport(const SocketTransport&) = delete;
+  ~SocketTransport();
+
+  int rank() const override;
+  int size() const override;
+  void send(int to, const std::vector<uint64_t>& message) override;
+  std::vector<uint64_t> receive(int from) override;
+
+private:
+  int my_rank;
+  std::vector<int> peer_fds;
+};
+
+// Rows of the landscape owned by one process, plus one halo row on each side
+struct LandscapeStrip {
+  size_t width, height; // of the whole landscape
+  size_t first_row, last_row; // rows [first_row, last_row) are owned by this process
+  size_t halo_first_row; // global row of the first row stored in `layers`
+  LandscapeSoA layers;
+};
+
+// Rows [first_row, last_row) owned by `rank` when `height` rows are split in `n_ranks` strips
+std::pair<size_t, size_t> strip_rows(size_t height, int rank, int n_ranks);
+
+// Reads only the rows of the strip of `rank` (and its halo) from the landscape files
+LandscapeStrip load_landscape_strip(
+    std::string metadata_filename, std::string data_filename, int rank, int n_ranks
+);
+
+/* Simulates one replicate cooperatively with the other processes of `transport`. Every process
+ * must call it with the same arguments except for its own strip. The whole fire is gathered on
+ * rank 0; other ranks get a Fire without burned cells. The processed cells are summed over every
+ * rank, so all ranks return the same total.
+ */
+Fire simulate_fire_distributed(
+    Transport& transport, const LandscapeStrip& strip,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, int n_replicate, float upper_limit
+);
@@ -0,0 +1,304 @@
+#include "fire_archive.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "trace.hpp"
+
+namespace {
+
+const char ARCHIVE_MAGIC[8] = { 'F', 'I', 'R', 'E', 'A', 'R', 'C', '1' };
+const uint32_t RECORD_MAGIC = 0x46524543; // "FREC"
+
+struct ArchiveHeader {
+  char magic[8];
+  uint64_t width;
+  uint64_t height;
+};
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t processed_cells;
+  uint64_t replicate;
+  uint64_t seed;
+  uint64_t n_burned;
+  uint64_t n_steps;
+  uint64_t payload_bytes;
+  SimulationParams params;
+};
+
+void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(uint8_t(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(uint8_t(value));
+}
+
+uint64_t get_varint(const std::vector<uint8_t>& in, size_t& pos) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos >= in.size()) {
+      break;
+    }
+    uint8_t byte = in[pos++];
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Corrupted fire archive record");
+}
+
+/* Payload: the step sizes, then for every row with burned cells the gap to the previous such row,
+ * the number of runs and, for each run, the gap from the end of the previous run and its length.
+ */
+std::vector<uint8_t> encode_payload(const ArchivedFire& fire, size_t width) {
+  std::vector<uint8_t> out;
+  for (size_t step_size : fire.step_sizes) {
+    put_varint(out, step_size);
+  }
+
+  std::vector<uint32_t> cells = fire.burned_cells;
+  std::sort(cells.begin(), cells.end());
+
+  size_t b = 0;
+  size_t previous_row = 0;
+  std::vector<std::pair<size_t, size_t>> runs;
+  while (b < cells.size()) {
+    size_t row = cells[b] / width;
+    runs.clear();
+    while (b < cells.size() && cells[b] / width == row) {
+      size_t start = cells[b] % width;
+      size_t length = 1;
+      b++;
+      while (b < cells.size() && cells[b] == cells[b - 1] + 1 && cells[b] / width == row) {
+        length++;
+        b++;
+      }
+      runs.push_back({ start, length });
+    }
+    put_varint(out, row - previous_row);
+    put_varint(out, runs.size());
+    size_t previous_end = 0;
+    for (auto [start, length] : runs) {
+      put_varint(out, start - previous_end);
+      put_varint(out, length - 1);
+      previous_end = start + length;
+    }
+    previous_row = row;
+  }
+  return out;
+}
+
+void decode_payload(
+    const std::vector<uint8_t>& in, const RecordHeader& header, size_t width, size_t height,
+    ArchivedFire& fire
+) {
+  // Checked before allocating, every step size takes at least a byte of the payload
+  if (header.n_steps > in.size() || header.n_burned > width * height) {
+    throw std::runtime_error("Corrupted fire archive record");
+  }
+
+  size_t pos = 0;
+  fire.step_sizes.resize(header.n_steps);
+  for (size_t& step_size : fire.step_sizes) {
+    step_size = get_varint(in, pos);
+  }
+
+  fire.burned_cells.clear();
+  fire.burned_cells.reserve(header.n_burned);
+  size_t row = 0;
+  while (pos < in.size()) {
+    uint64_t row_gap = get_varint(in, pos);
+    if (row_gap >= height - row) {
+      throw std::runtime_error("Corrupted fire archive record");
+    }
+    row += row_gap;
+    size_t n_runs = get_varint(in, pos);
+    size_t x = 0;
+    for (size_t r = 0; r < n_runs; r++) {
+      uint64_t gap = get_varint(in, pos);
+      uint64_t length = get_varint(in, pos) + 1;
+      if (gap > width - x || length > width - x - gap ||
+          length > header.n_burned - fire.burned_cells.size()) {
+        throw std::runtime_error("Corrupted fire archive record");
+      }
+      x += gap;
+      for (size_t k = 0; k < length; k++) {
+        fire.burned_cells.push_back(utils::INDEX(x + k, row, width));
+      }
+      x += length;
+    }
+  }
+  if (fire.burned_cells.size() != header.n_burned) {
+    throw std::runtime_error("Corrupted fire archive record");
+  }
+}
+
+} // namespace
+
+ArchivedFire archived_fire(
+    const Fire& fire, size_t replicate, uint64_t seed, const SimulationParams& params
+) {
+  ArchivedFire archived = {
+    replicate, seed, params, fire.processed_cells, fire.burned_cells, {}
+  };
+  size_t begin = 0;
+  for (size_t end : fire.burned_ids_steps) {
+    archived.step_sizes.push_back(end - begin);
+    begin = end;
+  }
+  return archived;
+}
+
+FireArchiveWriter::FireArchiveWriter(
+    std::string filename, size_t width, size_t height, size_t queue_capacity
+)
+    : file(filename, std::ios::binary | std::ios::trunc), archive_width(width),
+      archive_height(height), queue(queue_capacity) {
+  if (!file.is_open()) {
+    throw std::runtime_error("Can't create fire archive " + filename);
+  }
+  ArchiveHeader header;
+  std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+  header.width = width;
+  header.height = height;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.flush();
+
+  writer = std::thread(&FireArchiveWriter::write_loop, this);
+}
+
+FireArchiveWriter::~FireArchiveWriter() {
+  try {
+    close();
+  } catch (std::runtime_error&) {
+    // Errors are only reported by an explicit close
+  }
+}
+
+void FireArchiveWriter::append(ArchivedFire fire) {
+  if (!queue.push(std::move(fire))) {
+    throw std::runtime_error("Fire archive is closed");
+  }
+}
+
+void FireArchiveWriter::close() {
+  if (!closed) {
+    closed = true;
+    queue.close();
+    writer.join();
+    file.close();
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+}
+
+void FireArchiveWriter::write_loop() {
+  while (std::optional<ArchivedFire> fire = queue.pop()) {
+    if (!error.empty()) {
+      continue; // keep draining so that `append` never blocks forever
+    }
+    TRACE_SPAN("archive_fire", "output", "replicate", fire->replicate);
+
+    std::vector<uint8_t> payload = encode_payload(*fire, archive_width);
+
+    RecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = RECORD_MAGIC;
+    header.processed_cells = fire->processed_cells;
+    header.replicate = fire->replicate;
+    header.seed = fire->seed;
+    header.n_burned = fire->burned_cells.size();
+    header.n_steps = fire->step_sizes.size();
+    header.payload_bytes = payload.size();
+    header.params = fire->params;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    file.flush();
+    if (!file) {
+      error = "Can't write fire archive record";
+    }
+  }
+}
+
+FireArchiveReader::FireArchiveReader(std::string filename)
+    : file(filename, std::ios::binary) {
+  if (!file.is_open()) {
+    throw std::runtime_error("Can't open fire archive " + filename);
+  }
+
+  ArchiveHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+    throw std::runtime_error("Invalid fire archive " + filename);
+  }
+  archive_width = header.width;
+  archive_height = header.height;
+
+  file.seekg(0, std::ios::end);
+  uint64_t file_size = file.tellg();
+
+  // Index every complete record, a truncated last record (a writer that didn't finish) is ignored
+  uint64_t offset = sizeof(header);
+  RecordHeader record;
+  while (offset + sizeof(record) <= file_size) {
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(&record), sizeof(record));
+    if (record.magic != RECORD_MAGIC) {
+      throw std::runtime_error("Invalid fire archive " + filename);
+    }
+    uint64_t bytes = sizeof(record) + record.payload_bytes;
+    if (offset + bytes > file_size) {
+      break;
+    }
+    if (!offsets.count(record.replicate)) {
+      replicate_order.push_back(record.replicate);
+    }
+    offsets[record.replicate] = { offset, bytes };
+    offset += bytes;
+  }
+  file.clear();
+}
+
+ArchivedFire FireArchiveReader::read(size_t replicate) {
+  auto it = offsets.find(replicate);
+  if (it == offsets.end()) {
+    throw std::runtime_error("Replicate " + std::to_string(replicate) + " is not in the archive");
+  }
+
+  RecordHeader header;
+  file.seekg(it->second.offset);
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  std::vector<uint8_t> payload(header.payload_bytes);
+  file.read(reinterpret_cast<char*>(payload.data()), payload.size());
+  if (!file) {
+    file.clear();
+    throw std::runtime_error("Can't read fire archive record");
+  }
+
+  ArchivedFire fire = {
+    header.replicate, header.seed, header.params, header.processed_cells, {}, {}
+  };
+  decode_payload(payload, header, archive_width, archive_height, fire);
+  return fire;
+}
+
+size_t FireArchiveReader::record_bytes(size_t replicate) const {
+  auto it = offsets.find(replicate);
+  return it == offsets.end() ? 0 : it->second.bytes;
+}
+
+Fire FireArchiveReader::read_fire(size_t replicate) {
+  ArchivedFire archived = read(replicate);
+  Fire fire = empty_fire(archive_width, archive_height);
+  for (uint32_t idx : archived.burned_cells) {
+    fire.add_burned(idx);
+  }
+  fire.processed_cells = archived.processed_cells;
+  return fire;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "fires.hpp"
+#include "spread_functions.cuh"
+
+/* Append-only archive with every simulated fire of an ensemble.
+ *
+ * Each record holds the replicate number, seed, parameters, processed cells and the size of every
+ * step, followed by the burned set encoded row by row as runs of consecutive burned cells (varint
+ * gaps and lengths). The size of a record grows with the number of runs, i.e. with the perimeter of
+ * the fire, and not with the size of the landscape. The order in which cells burned within the fire
+ * is not kept, only the set.
+ *
+ * Records are appended as they are written, so a reader can open an archive that is still being
+ * written (or whose writer died) and sees every complete record.
+ */
+
+struct ArchivedFire {
+  size_t replicate;
+  uint64_t seed;
+  SimulationParams params;
+  unsigned int processed_cells;
+  // Linear indices of the burned cells; when read back they are sorted
+  std::vector<uint32_t> burned_cells;
+  // Number of cells burned in each step (the ignition cells are step 0)
+  std::vector<size_t> step_sizes;
+};
+
+// Builds the record for a simulated fire
+ArchivedFire archived_fire(
+    const Fire& fire, size_t replicate, uint64_t seed, const SimulationParams& params
+);
+
+/* Encodes and appends fires on a background thread. `append` only copies the burned set into a
+ * bounded queue, so the simulation loop doesn't wait for the disk unless the writer falls more than
+ * `queue_capacity` fires behind.
+ */
+class FireArchiveWriter {
+public:
+  FireArchiveWriter(
+      std::string filename, size_t width, size_t height, size_t queue_capacity = 64
+  );
+  FireArchiveWriter(const FireArchiveWriter&) = delete;
+  ~FireArchiveWriter();
+
+  void append(ArchivedFire fire);
+
+  // Waits until every appended fire is written. Throws if the writer failed.
+  void close();
+
+  size_t width() const {
+    return archive_width;
+  }
+  size_t height() const {
+    return archive_height;
+  }
+
+private:
+  void write_loop();
+
+  std::ofstream file;
+  size_t archive_width, archive_height;
+  BoundedQueue<ArchivedFire> queue;
+  std::thread writer;
+  std::string error;
+  bool closed = false;
+};
+
+// Random access by replicate to the records of an archive
+class FireArchiveReader {
+public:
+  explicit FireArchiveReader(std::string filename);
+
+  size_t width() const {
+    return archive_width;
+  }
+  size_t height() const {
+    return archive_height;
+  }
+
+  // Replicates in the archive, in the order they were written
+  const std::vector<size_t>& replicates() const {
+    return replicate_order;
+  }
+  bool contains(size_t replicate) const {
+    return offsets.count(replicate) != 0;
+  }
+
+  ArchivedFire read(size_t replicate);
+
+  // Size on disk of the record of `replicate`, header included
+  size_t record_bytes(size_t replicate) const;
+
+  // Fire with the burned set of `replicate` (burned_cells sorted, no steps)
+  Fire read_fire(size_t replicate);
+
+private:
+  struct RecordPosition {
+    uint64_t offset;
+    uint64_t bytes;
+  };
+
+  std::ifstream file;
+  size_t archive_width, archive_height;
+  std::vector<size_t> replicate_order;
+  std::unordered_map<size_t, RecordPosition> offsets;
+};
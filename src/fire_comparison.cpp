@@ -0,0 +1,163 @@
+#include "fire_comparison.hpp"
+
+#include <stdexcept>
+
+#include "trace.hpp"
+
+// The build doesn't pass -march, so the dense loops are also compiled for CPUs with a popcount
+// instruction and the loader picks the best version (otherwise every popcount is a libgcc call)
+#define POPCOUNT_CLONES __attribute__((target_clones("popcnt", "default")))
+
+namespace {
+
+inline size_t popcount(uint64_t word) {
+  return __builtin_popcountll(word);
+}
+
+void check_sizes(const Fire& fire, size_t width, size_t height) {
+  if (fire.width != width || fire.height != height) {
+    throw std::runtime_error("Can't compare fires of different landscape sizes");
+  }
+}
+
+bool mask_bit(const std::vector<uint64_t>& mask, size_t idx) {
+  return (mask[idx >> 6] >> (idx & 63)) & 1;
+}
+
+FireOverlap overlap_from_counts(size_t observed, size_t simulated, size_t intersection) {
+  size_t union_cells = observed + simulated - intersection;
+  return {
+    observed,
+    simulated,
+    intersection,
+    union_cells,
+    union_cells == 0 ? 1.0 : double(intersection) / union_cells,
+    double(simulated) / observed,
+  };
+}
+
+// Fused pass over the words of both fires and the masks
+POPCOUNT_CLONES FireComparison compare_dense(
+    const Fire& observed, size_t observed_cells, const Fire& simulated, const VegetationMasks& masks
+) {
+  const uint64_t* obs = observed.burned_bits.data();
+  const uint64_t* sim = simulated.burned_bits.data();
+  const uint64_t* subalpine = masks.subalpine.data();
+  const uint64_t* wet = masks.wet.data();
+  const uint64_t* dry = masks.dry.data();
+  size_t n_words = simulated.burned_bits.size();
+
+  size_t n_intersection = 0, n_subalpine = 0, n_wet = 0, n_dry = 0;
+  for (size_t w = 0; w < n_words; w++) {
+    uint64_t bits = sim[w];
+    n_intersection += popcount(bits & obs[w]);
+    n_subalpine += popcount(bits & subalpine[w]);
+    n_wet += popcount(bits & wet[w]);
+    n_dry += popcount(bits & dry[w]);
+  }
+
+  size_t simulated_cells = simulated.n_burned();
+  return {
+    overlap_from_counts(observed_cells, simulated_cells, n_intersection),
+    { simulated_cells - n_subalpine - n_wet - n_dry, n_subalpine, n_wet, n_dry },
+  };
+}
+
+// Same as compare_dense, visiting only the burned cells of `simulated`
+FireComparison compare_sparse(
+    const Fire& observed, size_t observed_cells, const Fire& simulated, const VegetationMasks& masks
+) {
+  size_t n_intersection = 0, n_subalpine = 0, n_wet = 0, n_dry = 0;
+  for (uint32_t idx : simulated.burned_cells) {
+    n_intersection += observed.is_burned(idx);
+    n_subalpine += mask_bit(masks.subalpine, idx);
+    n_wet += mask_bit(masks.wet, idx);
+    n_dry += mask_bit(masks.dry, idx);
+  }
+
+  size_t simulated_cells = simulated.n_burned();
+  return {
+    overlap_from_counts(observed_cells, simulated_cells, n_intersection),
+    { simulated_cells - n_subalpine - n_wet - n_dry, n_subalpine, n_wet, n_dry },
+  };
+}
+
+POPCOUNT_CLONES size_t dense_intersection(const Fire& a, const Fire& b) {
+  size_t n_intersection = 0;
+  for (size_t w = 0; w < a.burned_bits.size(); w++) {
+    n_intersection += popcount(a.burned_bits[w] & b.burned_bits[w]);
+  }
+  return n_intersection;
+}
+
+// A burned cell costs a few random accesses, a word of the dense pass 5 sequential loads
+bool is_sparse(const Fire& fire) {
+  return fire.n_burned() * 4 < fire.burned_bits.size();
+}
+
+} // namespace
+
+VegetationMasks vegetation_masks(const LandscapeSoA& landscape) {
+  size_t n_cells = landscape.width * landscape.height;
+  size_t n_words = (n_cells + 63) / 64;
+  VegetationMasks masks = {
+    landscape.width, landscape.height,
+    std::vector<uint64_t>(n_words, 0), std::vector<uint64_t>(n_words, 0), std::vector<uint64_t>(n_words, 0),
+  };
+  for (size_t idx = 0; idx < n_cells; idx++) {
+    uint64_t bit = uint64_t(1) << (idx & 63);
+    float vegetation = landscape.vegetation_type[idx];
+    if (vegetation == SUBALPINE) {
+      masks.subalpine[idx >> 6] |= bit;
+    } else if (vegetation == WET) {
+      masks.wet[idx >> 6] |= bit;
+    } else if (vegetation == DRY) {
+      masks.dry[idx >> 6] |= bit;
+    }
+  }
+  return masks;
+}
+
+FireStats get_fire_stats(const Fire& fire, const VegetationMasks& masks) {
+  check_sizes(fire, masks.width, masks.height);
+  FireComparison comparison = is_sparse(fire) ? compare_sparse(fire, 0, fire, masks)
+                                              : compare_dense(fire, 0, fire, masks);
+  return comparison.simulated_stats;
+}
+
+FireOverlap fire_overlap(const Fire& observed, const Fire& simulated) {
+  check_sizes(simulated, observed.width, observed.height);
+
+  size_t n_intersection = 0;
+  if (is_sparse(simulated)) {
+    for (uint32_t idx : simulated.burned_cells) {
+      n_intersection += observed.is_burned(idx);
+    }
+  } else {
+    n_intersection = dense_intersection(simulated, observed);
+  }
+  return overlap_from_counts(observed.n_burned(), simulated.n_burned(), n_intersection);
+}
+
+std::vector<FireComparison> compare_fires(
+    const Fire& observed, const std::vector<Fire>& simulated, const VegetationMasks& masks
+) {
+  TRACE_SPAN("compare_fires", "results", "fires", simulated.size());
+
+  check_sizes(observed, masks.width, masks.height);
+  for (const Fire& fire : simulated) {
+    check_sizes(fire, masks.width, masks.height);
+  }
+
+  size_t observed_cells = observed.n_burned();
+  std::vector<FireComparison> comparisons(simulated.size());
+
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (size_t f = 0; f < simulated.size(); f++) {
+    comparisons[f] = is_sparse(simulated[f])
+                         ? compare_sparse(observed, observed_cells, simulated[f], masks)
+                         : compare_dense(observed, observed_cells, simulated[f], masks);
+  }
+
+  return comparisons;
+}
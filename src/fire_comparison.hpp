@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fires.hpp"
+#include "landscape.hpp"
+
+/* Comparison of fires over their bit-packed burned layers (`Fire::burned_bits`).
+ *
+ * Set sizes are computed with popcounts over 64 cells at a time, and vegetation counts by
+ * intersecting the burned bits with one precomputed bitset per vegetation class, so comparing two
+ * fires reads 1 bit per cell of every operand instead of one float per burned cell.
+ */
+
+// One bitset per vegetation class over the cells of a landscape, with the layout of
+// `Fire::burned_bits`. Cells of any other value count as matorral, like in `get_fire_stats`.
+struct VegetationMasks {
+  size_t width, height;
+  std::vector<uint64_t> subalpine;
+  std::vector<uint64_t> wet;
+  std::vector<uint64_t> dry;
+};
+
+VegetationMasks vegetation_masks(const LandscapeSoA& landscape);
+
+// Same result as `get_fire_stats(fire, landscape)`
+FireStats get_fire_stats(const Fire& fire, const VegetationMasks& masks);
+
+struct FireOverlap {
+  size_t observed_cells;
+  size_t simulated_cells;
+  size_t intersection;
+  size_t union_cells;
+  double jaccard; // intersection / union, 1 if both fires are empty
+  double size_ratio; // simulated / observed cells (not finite if the observed fire is empty)
+};
+
+FireOverlap fire_overlap(const Fire& observed, const Fire& simulated);
+
+struct FireComparison {
+  FireOverlap overlap;
+  FireStats simulated_stats;
+};
+
+// Scores every simulated fire against `observed` in a single pass over the bits of each one.
+// Fires are processed in parallel; small fires are scored from their burned cells instead.
+std::vector<FireComparison> compare_fires(
+    const Fire& observed, const std::vector<Fire>& simulated, const VegetationMasks& masks
+);
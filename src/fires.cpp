@@ -17,9 +17,7 @@ Fire read_fire(size_t width, size_t height, std::string filename) {
   CSVIterator loop(burned_ids_file);
   loop++;
 
-  std::vector<int> burned_layer(width * height, false);
-  std::vector<size_t> burned_ids_0;
-  std::vector<size_t> burned_ids_1;
+  Fire fire = empty_fire(width, height);
 
   for (; loop != CSVIterator(); ++loop) {
     if (loop->size() < 2) {
@@ -30,29 +28,27 @@ Fire read_fire(size_t width, size_t height, std::string filename) {
     if (x >= width || y >= height) {
       throw std::runtime_error("Invalid fire file");
     }
-    burned_layer[utils::INDEX(x, y, width)] = 1;
-    burned_ids_0.push_back(x);
-    burned_ids_1.push_back(y);
+    size_t idx = utils::INDEX(x, y, width);
+    if (!fire.is_burned(idx)) {
+      fire.add_burned(idx);
+    }
   }
 
   burned_ids_file.close();
 
-  return { width, height, 0, 0, burned_layer, burned_ids_0, burned_ids_1, {} };
+  return fire;
 }
 
 Fire empty_fire(size_t width, size_t height) {
-  return { width, height, 0, 0, std::vector<int>(width * height), {}, {}, {} };
+  Fire fire = { 0, 0, 0, 0, {}, {}, {} };
+  fire.reset(width, height);
+  return fire;
 }
 
 FireStats get_fire_stats(const Fire& fire, const LandscapeSoA& landscape) {
 
   FireStats stats = { 0, 0, 0, 0 };
-  size_t n = fire.burned_ids_0.size();
-  for (size_t i = 0; i < n; i++) {
-    size_t x = fire.burned_ids_0[i];
-    size_t y = fire.burned_ids_1[i];
-    size_t idx = utils::INDEX(x, y, landscape.width);
-
+  for (uint32_t idx : fire.burned_cells) {
     if (landscape.vegetation_type[idx] == SUBALPINE) {
       stats.counts_veg_subalpine++;
     } else if (landscape.vegetation_type[idx] == WET) {
@@ -65,4 +61,4 @@ FireStats get_fire_stats(const Fire& fire, const LandscapeSoA& landscape) {
   }
 
   return stats;
-}
\ No newline at end of file
+}
@@ -7,23 +7,99 @@
 #include "landscape.hpp"
 #include "matrix.hpp"
 
+/* Burned cells of a fire.
+ *
+ * The burned set is kept compactly: the linear indices (x + y * width) of the burned cells in the
+ * order they burned, plus a bitset over the grid for O(1) membership. A Fire can be reused across
+ * replicates with `reset`, which only clears the bits of the previous fire and keeps the capacity
+ * of the vectors, so simulating many replicates into the same Fire doesn't allocate.
+ */
 struct Fire {
   size_t width;
   size_t height;
   unsigned int processed_cells; // number of cells processed in the simulation TODO: Revisar si usamos size_t o int
   double time_taken; // time spent in the simulation
-  std::vector<int> burned_layer;
-  std::vector<size_t> burned_ids_0;
-  std::vector<size_t> burned_ids_1;
-  // Positions in burned_ids where a new step starts, empty if the fire was not simulated
+  std::vector<uint32_t> burned_cells;
+  std::vector<uint64_t> burned_bits;
+  // Positions in burned_cells where a new step starts, empty if the fire was not simulated
   std::vector<size_t> burned_ids_steps;
+
+  // Empties the fire for a landscape of the given size
+  void reset(size_t new_width, size_t new_height) {
+    if (new_width == width && new_height == height && !burned_bits.empty()) {
+      for (uint32_t idx : burned_cells) {
+        burned_bits[idx >> 6] = 0;
+      }
+    } else {
+      width = new_width;
+      height = new_height;
+      burned_bits.assign((width * height + 63) / 64, 0);
+    }
+    burned_cells.clear();
+    burned_ids_steps.clear();
+    processed_cells = 0;
+    time_taken = 0.0;
+  }
+
+  // Marks a cell that is not burned yet
+  void add_burned(uint32_t idx) {
+    burned_cells.push_back(idx);
+    burned_bits[idx >> 6] |= uint64_t(1) << (idx & 63);
+  }
+
+  bool is_burned(size_t idx) const {
+    return (burned_bits[idx >> 6] >> (idx & 63)) & 1;
+  }
+
+  size_t n_burned() const {
+    return burned_cells.size();
+  }
+
+  // Bytes allocated by the vectors, which only grow while the Fire is reused
+  size_t capacity_bytes() const {
+    return burned_cells.capacity() * sizeof(uint32_t) + burned_bits.capacity() * sizeof(uint64_t) +
+           burned_ids_steps.capacity() * sizeof(size_t);
+  }
+
+  /* Read-only views with the interface of the former dense representation */
+
+  struct BurnedLayerView {
+    const Fire& fire;
+    int operator[](size_t idx) const {
+      return fire.is_burned(idx);
+    }
+    size_t size() const {
+      return fire.width * fire.height;
+    }
+  };
+
+  // Column (coordinate 0) or row (coordinate 1) of each burned cell, in burn order
+  struct BurnedIdsView {
+    const Fire& fire;
+    int coordinate;
+    size_t operator[](size_t b) const {
+      return coordinate == 0 ? fire.burned_cells[b] % fire.width : fire.burned_cells[b] / fire.width;
+    }
+    size_t size() const {
+      return fire.burned_cells.size();
+    }
+  };
+
+  BurnedLayerView burned_layer() const {
+    return { *this };
+  }
+  BurnedIdsView burned_ids_0() const {
+    return { *this, 0 };
+  }
+  BurnedIdsView burned_ids_1() const {
+    return { *this, 1 };
+  }
+
   bool operator==(const Fire& other) const {
     return 
       width == other.width && 
       height == other.height &&
-      burned_layer == other.burned_layer && 
-      burned_ids_0 == other.burned_ids_0 &&
-      burned_ids_1 == other.burned_ids_1;
+      burned_bits == other.burned_bits;
   }
 };
 
@@ -0,0 +1,393 @@
+#include "firespread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "derived_layers.hpp"
+#include "ignition_cells.hpp"
+#include "landscape.hpp"
+#include "reachable_region.hpp"
+#include "spread_functions.cuh"
+#include "spread_functions_cpu.hpp"
+
+static_assert(sizeof(fs_params) == sizeof(SimulationParams), "fs_params must match SimulationParams");
+
+struct fs_landscape {
+  LandscapeSoA layers;
+  // Derived layers of the host engine and the model they were computed for
+  std::optional<DerivedLayers> derived;
+  fs_model derived_model;
+};
+
+struct fs_fire {
+  Fire fire;
+  CpuFireState state;
+  std::vector<int32_t> arrival_steps;
+};
+
+struct fs_ensemble {
+  size_t width, height, n_replicates;
+  std::vector<uint64_t> burned_amounts;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// Runs `body`, turning exceptions into -1 and the message of `fs_last_error`
+template <typename Body> int guarded(Body body) {
+  try {
+    body();
+    return 0;
+  } catch (const std::exception& e) {
+    last_error = e.what();
+    return -1;
+  } catch (...) {
+    // Nothing may unwind out of an extern "C" function
+    last_error = "Unknown error";
+    return -1;
+  }
+}
+
+template <typename T, typename Body> T* guarded_new(Body body) {
+  T* result = nullptr;
+  guarded([&]() { result = body(); });
+  return result;
+}
+
+SimulationParams simulation_params(const fs_params* params) {
+  return { params->independent_pred, params->wind_pred,     params->elevation_pred,
+           params->slope_pred,       params->subalpine_pred, params->wet_pred,
+           params->dry_pred,         params->fwi_pred,       params->aspect_pred };
+}
+
+IgnitionCells ignition_cells_of(
+    const fs_landscape* landscape, const size_t* cells, size_t n_cells
+) {
+  IgnitionCells ignition_cells;
+  for (size_t c = 0; c < n_cells; c++) {
+    size_t x = cells[2 * c];
+    size_t y = cells[2 * c + 1];
+    if (x >= landscape->layers.width || y >= landscape->layers.height) {
+      throw std::runtime_error("Ignition cell outside the landscape");
+    }
+    ignition_cells.push_back({ x, y });
+  }
+  return ignition_cells;
+}
+
+// Derived layers of `landscape` for `model`, which must have been prepared
+DerivedView prepared_view(const fs_landscape* landscape, const fs_model* model) {
+  const fs_model& prepared = landscape->derived_model;
+  if (!landscape->derived || prepared.distance != model->distance ||
+      prepared.elevation_mean != model->elevation_mean ||
+      prepared.elevation_sd != model->elevation_sd) {
+    throw std::runtime_error("The CPU engine needs fs_landscape_prepare with the same model");
+  }
+  return landscape->derived->view();
+}
+
+void check_engine(fs_engine engine) {
+  if (engine != FS_ENGINE_GPU && engine != FS_ENGINE_CPU) {
+    throw std::runtime_error("Unknown engine");
+  }
+}
+
+} // namespace
+
+extern "C" {
+
+int fs_api_version(void) {
+  return FS_API_VERSION;
+}
+
+const char* fs_last_error(void) {
+  return last_error.c_str();
+}
+
+fs_landscape* fs_landscape_load(const char* prefix) {
+  return guarded_new<fs_landscape>([&]() {
+    std::string landscape_file_prefix = prefix;
+    return new fs_landscape{
+      LandscapeSoA(landscape_file_prefix + "-metadata.csv", landscape_file_prefix + "-landscape.csv"),
+      std::nullopt,
+      {},
+    };
+  });
+}
+
+fs_landscape* fs_landscape_from_arrays(
+    size_t width, size_t height, const float* elevation, const float* fwi, const float* aspect,
+    const float* vegetation_type, const float* wind_dir, const uint8_t* burnable
+) {
+  return guarded_new<fs_landscape>([&]() {
+    fs_landscape* landscape = new fs_landscape{ LandscapeSoA(width, height), std::nullopt, {} };
+    LandscapeSoA& layers = landscape->layers;
+    size_t n_cells = width * height;
+    std::copy(elevation, elevation + n_cells, layers.elevation.begin());
+    std::copy(fwi, fwi + n_cells, layers.fwi.begin());
+    std::copy(aspect, aspect + n_cells, layers.aspect.begin());
+    std::copy(vegetation_type, vegetation_type + n_cells, layers.vegetation_type.begin());
+    std::copy(wind_dir, wind_dir + n_cells, layers.wind_dir.begin());
+    std::copy(burnable, burnable + n_cells, layers.burnable.begin());
+    return landscape;
+  });
+}
+
+void fs_landscape_free(fs_landscape* landscape) {
+  delete landscape;
+}
+
+size_t fs_landscape_width(const fs_landscape* landscape) {
+  return landscape->layers.width;
+}
+
+size_t fs_landscape_height(const fs_landscape* landscape) {
+  return landscape->layers.height;
+}
+
+int fs_landscape_prepare(
+    fs_landscape* landscape, const fs_model* model, const char* sidecar_filename
+) {
+  return guarded([&]() {
+    LandscapeView view = landscape->layers.view();
+    landscape->derived.reset();
+    if (sidecar_filename) {
+      landscape->derived.emplace(DerivedLayers::open_or_build(
+          view, sidecar_filename, model->distance, model->elevation_mean, model->elevation_sd
+      ));
+    } else {
+      landscape->derived.emplace(DerivedLayers::compute(
+          view, model->distance, model->elevation_mean, model->elevation_sd
+      ));
+    }
+    landscape->derived_model = *model;
+  });
+}
+
+long fs_read_ignition_cells(const char* prefix, size_t* cells, size_t capacity) {
+  long n_cells = -1;
+  guarded([&]() {
+    IgnitionCells ignition_cells =
+        read_ignition_cells(std::string(prefix) + "-ignition_points.csv");
+    for (size_t c = 0; c < ignition_cells.size() && c < capacity; c++) {
+      cells[2 * c] = ignition_cells[c].first;
+      cells[2 * c + 1] = ignition_cells[c].second;
+    }
+    n_cells = ignition_cells.size();
+  });
+  return n_cells;
+}
+
+fs_fire* fs_fire_new(void) {
+  return guarded_new<fs_fire>([]() {
+    return new fs_fire{
+      empty_fire(0, 0), { 0, { EdgeStream::INDEPENDENT, 0, 1 }, {}, {}, {}, 0, 0 }, {}
+    };
+  });
+}
+
+void fs_fire_free(fs_fire* fire) {
+  delete fire;
+}
+
+int fs_simulate_fire(
+    const fs_landscape* landscape, const size_t* ignition_cells, size_t n_ignition_cells,
+    const fs_params* params, const fs_model* model, int n_replicate, fs_engine engine,
+    fs_fire* fire
+) {
+  return guarded([&]() {
+    check_engine(engine);
+    IgnitionCells cells = ignition_cells_of(landscape, ignition_cells, n_ignition_cells);
+    LandscapeView view = landscape->layers.view();
+    fire->arrival_steps.clear();
+
+    if (engine == FS_ENGINE_GPU) {
+      simulate_fire(
+          view, cells, simulation_params(params), model->distance, model->elevation_mean,
+          model->elevation_sd, n_replicate, model->upper_limit, fire->fire
+      );
+      return;
+    }
+
+    DerivedView derived = prepared_view(landscape, model);
+    auto start = std::chrono::steady_clock::now();
+    restart_fire_cpu(fire->state, view, cells, replicate_seed(n_replicate));
+    SimulationParams simulation = simulation_params(params);
+    while (advance_fire_step_cpu(fire->state, view, derived, simulation, model->upper_limit)) {
+    }
+    fire_from_state(fire->state, view.width, view.height, fire->fire);
+    fire->fire.time_taken =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  });
+}
+
+size_t fs_fire_width(const fs_fire* fire) {
+  return fire->fire.width;
+}
+
+size_t fs_fire_height(const fs_fire* fire) {
+  return fire->fire.height;
+}
+
+unsigned int fs_fire_processed_cells(const fs_fire* fire) {
+  return fire->fire.processed_cells;
+}
+
+double fs_fire_time_taken(const fs_fire* fire) {
+  return fire->fire.time_taken;
+}
+
+size_t fs_fire_n_burned(const fs_fire* fire) {
+  return fire->fire.n_burned();
+}
+
+const uint32_t* fs_fire_burned_cells(const fs_fire* fire) {
+  return fire->fire.burned_cells.data();
+}
+
+const int32_t* fs_fire_arrival_steps(fs_fire* fire) {
+  return guarded_new<const int32_t>([&]() {
+    // Computed on the first call after each simulation
+    const Fire& burned = fire->fire;
+    if (fire->arrival_steps.size() != burned.width * burned.height) {
+      fire->arrival_steps.assign(burned.width * burned.height, -1);
+      const std::vector<size_t>& steps = burned.burned_ids_steps;
+      int32_t step = 0;
+      for (size_t b = 0; b < burned.burned_cells.size(); b++) {
+        while (size_t(step) < steps.size() && b >= steps[step]) {
+          step++;
+        }
+        fire->arrival_steps[burned.burned_cells[b]] = step;
+      }
+    }
+    return fire->arrival_steps.data();
+  });
+}
+
+fs_ensemble* fs_ensemble_new(void) {
+  return guarded_new<fs_ensemble>([]() { return new fs_ensemble{ 0, 0, 0, {} }; });
+}
+
+void fs_ensemble_free(fs_ensemble* ensemble) {
+  delete ensemble;
+}
+
+int fs_simulate_ensemble(
+    const fs_landscape* landscape, const size_t* ignition_cells, size_t n_ignition_cells,
+    const fs_params* params, const fs_model* model, size_t first_replicate, size_t n_replicates,
+    fs_engine engine, fs_ensemble* ensemble
+) {
+  return guarded([&]() {
+    check_engine(engine);
+    IgnitionCells cells = ignition_cells_of(landscape, ignition_cells, n_ignition_cells);
+    const LandscapeSoA& layers = landscape->layers;
+    SimulationParams simulation = simulation_params(params);
+
+    ensemble->width = layers.width;
+    ensemble->height = layers.height;
+    ensemble->n_replicates = n_replicates;
+    ensemble->burned_amounts.assign(layers.width * layers.height, 0);
+    std::vector<uint64_t>& burned_amounts = ensemble->burned_amounts;
+
+    if (engine == FS_ENGINE_GPU) {
+      // Simulated on the reachable region, see burned_amounts_per_cell
+      CropWindow window = reachable_window(layers, cells);
+      LandscapeView cropped_view = window_view(layers.view(), window);
+      IgnitionCells cropped_cells = crop_ignition_cells(cells, window);
+      Fire fire = empty_fire(window.width, window.height);
+      for (size_t i = first_replicate; i < first_replicate + n_replicates; i++) {
+        simulate_fire(
+            cropped_view, cropped_cells, simulation, model->distance, model->elevation_mean,
+            model->elevation_sd, i, model->upper_limit, fire
+        );
+        for (uint32_t idx : fire.burned_cells) {
+          burned_amounts[utils::INDEX(
+              window.x0 + idx % window.width, window.y0 + idx / window.width, layers.width
+          )]++;
+        }
+      }
+      return;
+    }
+
+    // The host engine only touches the burned cells, so it runs on the whole prepared landscape
+    DerivedView derived = prepared_view(landscape, model);
+    LandscapeView view = layers.view();
+
+    // Exceptions can't leave the parallel region, each thread keeps its own and the first one is
+    // rethrown after it. The remaining replicates are skipped once any thread failed
+    std::vector<std::exception_ptr> errors(omp_get_max_threads());
+    std::atomic<bool> failed(false);
+
+    #pragma omp parallel
+    {
+      std::exception_ptr& error = errors[omp_get_thread_num()];
+      std::optional<CpuFireState> state;
+      std::vector<uint32_t> counts;
+      try {
+        state.emplace(start_fire_cpu(view, cells, 0));
+        counts.assign(view.width * view.height, 0);
+      } catch (...) {
+        error = std::current_exception();
+        failed = true;
+      }
+
+      #pragma omp for schedule(dynamic)
+      for (size_t i = first_replicate; i < first_replicate + n_replicates; i++) {
+        if (failed) {
+          continue;
+        }
+        try {
+          restart_fire_cpu(*state, view, cells, replicate_seed(i));
+          while (advance_fire_step_cpu(*state, view, derived, simulation, model->upper_limit)) {
+          }
+          for (size_t idx : state->burned_ids) {
+            counts[idx]++;
+          }
+        } catch (...) {
+          error = std::current_exception();
+          failed = true;
+        }
+      }
+
+      if (!failed) {
+        #pragma omp critical
+        for (size_t idx = 0; idx < counts.size(); idx++) {
+          burned_amounts[idx] += counts[idx];
+        }
+      }
+    }
+
+    for (std::exception_ptr& error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+  });
+}
+
+size_t fs_ensemble_width(const fs_ensemble* ensemble) {
+  return ensemble->width;
+}
+
+size_t fs_ensemble_height(const fs_ensemble* ensemble) {
+  return ensemble->height;
+}
+
+size_t fs_ensemble_n_replicates(const fs_ensemble* ensemble) {
+  return ensemble->n_replicates;
+}
+
+const uint64_t* fs_ensemble_burned_amounts(const fs_ensemble* ensemble) {
+  return ensemble->burned_amounts.data();
+}
+
+} // extern "C"
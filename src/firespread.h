@@ -0,0 +1,129 @@
+#ifndef FIRESPREAD_H
+#define FIRESPREAD_H
+
+/* C API of the simulator, built as libfirespread.so (`make libfirespread.so`).
+ *
+ * Objects are opaque and owned by the library. Result arrays (burned cells, arrival steps, burned
+ * amounts) point into buffers of the object they come from and stay valid until the object is
+ * simulated into again or freed, so bindings can wrap them without copying.
+ *
+ * Functions returning int return 0 on success and -1 on error; functions returning a pointer return
+ * NULL on error. `fs_last_error` describes the last error of the calling thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FS_API_VERSION 1
+
+typedef struct fs_landscape fs_landscape;
+typedef struct fs_fire fs_fire;
+typedef struct fs_ensemble fs_ensemble;
+
+// Same fields and order as SimulationParams
+typedef struct fs_params {
+  float independent_pred;
+  float wind_pred;
+  float elevation_pred;
+  float slope_pred;
+  float subalpine_pred;
+  float wet_pred;
+  float dry_pred;
+  float fwi_pred;
+  float aspect_pred;
+} fs_params;
+
+typedef struct fs_model {
+  float distance;
+  float elevation_mean;
+  float elevation_sd;
+  float upper_limit;
+} fs_model;
+
+typedef enum fs_engine {
+  FS_ENGINE_GPU = 0, // the CUDA kernel, `simulate_fire`
+  FS_ENGINE_CPU = 1, // the host engine, `simulate_fire_cpu` (needs `fs_landscape_prepare`)
+} fs_engine;
+
+int fs_api_version(void);
+const char* fs_last_error(void);
+
+/* Landscapes */
+
+// Reads <prefix>-metadata.csv and <prefix>-landscape.csv
+fs_landscape* fs_landscape_load(const char* prefix);
+
+// Copies row-major layers of width * height cells
+fs_landscape* fs_landscape_from_arrays(
+    size_t width, size_t height, const float* elevation, const float* fwi, const float* aspect,
+    const float* vegetation_type, const float* wind_dir, const uint8_t* burnable
+);
+
+void fs_landscape_free(fs_landscape* landscape);
+size_t fs_landscape_width(const fs_landscape* landscape);
+size_t fs_landscape_height(const fs_landscape* landscape);
+
+// Computes the derived layers of the host engine for `model` (see derived_layers.hpp). If
+// `sidecar_filename` is not NULL they are read from / written to that file.
+int fs_landscape_prepare(
+    fs_landscape* landscape, const fs_model* model, const char* sidecar_filename
+);
+
+// Reads <prefix>-ignition_points.csv into `cells` as x0, y0, x1, y1, ... Returns the number of
+// ignition cells (all of them, even if more than `capacity`) or -1.
+long fs_read_ignition_cells(const char* prefix, size_t* cells, size_t capacity);
+
+/* Single replicates */
+
+fs_fire* fs_fire_new(void);
+void fs_fire_free(fs_fire* fire);
+
+// Simulates replicate `n_replicate` (seed 123 + n_replicate) into `fire`. `ignition_cells` holds
+// `n_ignition_cells` (x, y) pairs.
+int fs_simulate_fire(
+    const fs_landscape* landscape, const size_t* ignition_cells, size_t n_ignition_cells,
+    const fs_params* params, const fs_model* model, int n_replicate, fs_engine engine,
+    fs_fire* fire
+);
+
+size_t fs_fire_width(const fs_fire* fire);
+size_t fs_fire_height(const fs_fire* fire);
+unsigned int fs_fire_processed_cells(const fs_fire* fire);
+double fs_fire_time_taken(const fs_fire* fire);
+
+// Linear indices (x + y * width) of the burned cells, in the order they burned
+size_t fs_fire_n_burned(const fs_fire* fire);
+const uint32_t* fs_fire_burned_cells(const fs_fire* fire);
+
+// Step at which every cell burned (0 for the ignition cells), -1 if it did not burn
+const int32_t* fs_fire_arrival_steps(fs_fire* fire);
+
+/* Ensembles */
+
+fs_ensemble* fs_ensemble_new(void);
+void fs_ensemble_free(fs_ensemble* ensemble);
+
+// Simulates replicates first_replicate, ..., first_replicate + n_replicates - 1 and counts how
+// many times every cell burned
+int fs_simulate_ensemble(
+    const fs_landscape* landscape, const size_t* ignition_cells, size_t n_ignition_cells,
+    const fs_params* params, const fs_model* model, size_t first_replicate, size_t n_replicates,
+    fs_engine engine, fs_ensemble* ensemble
+);
+
+size_t fs_ensemble_width(const fs_ensemble* ensemble);
+size_t fs_ensemble_height(const fs_ensemble* ensemble);
+size_t fs_ensemble_n_replicates(const fs_ensemble* ensemble);
+
+// width * height counts, row-major
+const uint64_t* fs_ensemble_burned_amounts(const fs_ensemble* ensemble);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,8 +5,10 @@
 #include <vector>
 
 #include "csv.hpp"
+#include "trace.hpp"
 
 IgnitionCells read_ignition_cells(std::string filename) {
+  TRACE_SPAN("read_ignition_cells", "io");
 
   std::ifstream file(filename);
 
@@ -0,0 +1,161 @@
+#include "ignition_ensemble.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <omp.h>
+
+#include "csv.hpp"
+#include "derived_layers.hpp"
+#include "memory_accounting.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+namespace {
+
+// Offset of the seed of the ignition draws, so that they are not the draws of any edge
+constexpr uint64_t IGNITION_SEED_OFFSET = 0x2545f4914f6cdd1dULL;
+
+} // namespace
+
+std::vector<double> read_ignition_density(std::string filename, size_t width, size_t height) {
+  TRACE_SPAN("read_ignition_density", "io");
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    throw std::runtime_error("Can't open ignition density file " + filename);
+  }
+
+  CSVIterator loop_csv(file);
+  ++loop_csv;
+
+  std::vector<double> density(width * height);
+  for (size_t idx = 0; idx < density.size(); idx++, ++loop_csv) {
+    if (loop_csv == CSVIterator() || (*loop_csv).size() < 1) {
+      throw std::runtime_error("Invalid ignition density file " + filename);
+    }
+    density[idx] = atof((*loop_csv)[0].data());
+    if (!(density[idx] >= 0)) {
+      throw std::runtime_error("Negative ignition density in " + filename);
+    }
+  }
+  return density;
+}
+
+IgnitionSampler::IgnitionSampler(const LandscapeView& landscape, const std::vector<double>& density)
+    : width(landscape.width) {
+  size_t n_cells = landscape.width * landscape.height;
+  if (!density.empty() && density.size() != n_cells) {
+    throw std::runtime_error("The ignition density doesn't match the landscape");
+  }
+
+  double total = 0;
+  for (size_t idx = 0; idx < n_cells; idx++) {
+    double weight = density.empty() ? 1.0 : density[idx];
+    if (landscape.burnable[landscape.layer_index(idx)] && weight > 0) {
+      total += weight;
+      cumulative.push_back(total);
+      cells.push_back(idx);
+    }
+  }
+  if (cells.empty()) {
+    throw std::runtime_error("No burnable cell has a positive ignition density");
+  }
+  cumulative.shrink_to_fit();
+  cells.shrink_to_fit();
+}
+
+std::pair<size_t, size_t> IgnitionSampler::sample(size_t n_replicate) const {
+  uint64_t bits = edge_bits(replicate_seed(n_replicate) + IGNITION_SEED_OFFSET, 0, 0);
+  double u = (bits >> 11) * (1.0 / 9007199254740992.0) * cumulative.back();
+  size_t k = std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+  size_t cell = cells[std::min(k, cells.size() - 1)];
+  return { cell % width, cell / width };
+}
+
+IgnitionEnsemble simulate_ignition_ensemble(
+    const LandscapeSoA& landscape, const std::vector<double>& density, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit,
+    size_t n_replicates, size_t batch_size
+) {
+  LandscapeView view = landscape.view();
+  size_t n_cells = view.width * view.height;
+
+  IgnitionSampler sampler(view, density);
+  DerivedLayers derived = DerivedLayers::compute(view, distance, elevation_mean, elevation_sd);
+  MemoryUsage derived_usage(MemoryComponent::DERIVED_LAYERS, derived.bytes());
+  DerivedView derived_view = derived.view();
+  std::vector<uint32_t> threshold = edge_thresholds(view, derived_view, params, upper_limit);
+  // Chosen here, it can throw and the replicates run in a parallel region
+  ThresholdStep step = threshold_step(EdgeStream::INDEPENDENT);
+  MemoryUsage threshold_usage(
+      MemoryComponent::EDGE_PROBABILITIES, threshold.size() * sizeof(uint32_t) + sampler.bytes()
+  );
+
+  IgnitionEnsemble ensemble = {
+    Matrix<double>(view.width, view.height),
+    std::vector<std::pair<size_t, size_t>>(n_replicates),
+    std::vector<size_t>(n_replicates),
+  };
+  for (size_t r = 0; r < n_replicates; r++) {
+    ensemble.ignitions[r] = sampler.sample(r);
+  }
+  MemoryUsage ensemble_usage(
+      MemoryComponent::ACCUMULATORS,
+      n_cells * sizeof(double) +
+          n_replicates * (sizeof(std::pair<size_t, size_t>) + sizeof(size_t))
+  );
+
+  // Per thread counts, allocated by each thread
+  int n_threads = omp_get_max_threads();
+  std::vector<std::vector<uint32_t>> counts(n_threads);
+
+  #pragma omp parallel
+  {
+    std::vector<uint32_t>& local_counts = counts[omp_get_thread_num()];
+    local_counts.assign(n_cells, 0);
+    MemoryUsage counts_usage(MemoryComponent::ACCUMULATORS, n_cells * sizeof(uint32_t));
+    std::vector<std::pair<size_t, size_t>> ignition(1);
+    CpuFireState state = start_fire_cpu(view, {}, 0);
+    MemoryUsage state_usage(MemoryComponent::FIRE_BUFFERS);
+
+    #pragma omp for schedule(dynamic, std::max<size_t>(batch_size, 1))
+    for (size_t r = 0; r < n_replicates; r++) {
+      TRACE_SPAN("ignition_replicate", "simulation", "replicate", r);
+      ignition[0] = ensemble.ignitions[r];
+      restart_fire_cpu(state, view, ignition, replicate_seed(r));
+      while (step(state, derived_view, threshold.data())) {
+      }
+      for (size_t idx : state.burned_ids) {
+        local_counts[idx]++;
+      }
+      ensemble.fire_sizes[r] = state.burned_ids.size();
+      state_usage.set(state.capacity_bytes());
+    }
+  }
+
+  TRACE_SPAN("reduce_counts", "results");
+  #pragma omp parallel for schedule(static)
+  for (size_t idx = 0; idx < n_cells; idx++) {
+    size_t count = 0;
+    for (const std::vector<uint32_t>& local_counts : counts) {
+      if (!local_counts.empty()) { // empty if the team had fewer threads
+        count += local_counts[idx];
+      }
+    }
+    ensemble.burn_probability.elems[idx] = double(count) / n_replicates;
+  }
+  return ensemble;
+}
+
+std::vector<size_t> fire_size_histogram(const std::vector<size_t>& fire_sizes) {
+  std::vector<size_t> histogram;
+  for (size_t size : fire_sizes) {
+    size_t bin = size > 0 ? 63 - __builtin_clzll(size) : 0;
+    if (histogram.size() <= bin) {
+      histogram.resize(bin + 1, 0);
+    }
+    histogram[bin]++;
+  }
+  return histogram;
+}
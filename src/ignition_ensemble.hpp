@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+#include "matrix.hpp"
+#include "spread_functions.cuh"
+
+/* Burn probabilities over a whole landscape with random ignitions.
+ *
+ * Every replicate starts from a single cell drawn from an ignition density, so the result is the
+ * probability that each cell burns given that a fire starts somewhere in the landscape, and the
+ * fires are typically many and short. The landscape terms and the spread probability of every edge
+ * are computed once and shared by all the replicates (as the integer thresholds of
+ * `edge_thresholds`), which run on the host engine in batches of consecutive replicates scheduled
+ * dynamically among the threads.
+ */
+
+// Relative ignition density of every cell, read from a CSV with a header and one value per row in
+// the order of the landscape file (row by row)
+std::vector<double> read_ignition_density(std::string filename, size_t width, size_t height);
+
+// Draws ignition cells with probability proportional to the density of burnable cells (uniform over
+// them if the density is empty)
+class IgnitionSampler {
+public:
+  IgnitionSampler(const LandscapeView& landscape, const std::vector<double>& density);
+
+  // Ignition cell of replicate `n_replicate`, depends only on the replicate
+  std::pair<size_t, size_t> sample(size_t n_replicate) const;
+
+  // Bytes taken by the cumulative density
+  size_t bytes() const {
+    return cumulative.capacity() * sizeof(double) + cells.capacity() * sizeof(size_t);
+  }
+
+private:
+  size_t width;
+  // Cumulative density up to each burnable cell, and that cell
+  std::vector<double> cumulative;
+  std::vector<size_t> cells;
+};
+
+struct IgnitionEnsemble {
+  // Probability that each cell burns given an ignition drawn from the density
+  Matrix<double> burn_probability;
+  // Ignition cell and number of burned cells of every replicate
+  std::vector<std::pair<size_t, size_t>> ignitions;
+  std::vector<size_t> fire_sizes;
+};
+
+IgnitionEnsemble simulate_ignition_ensemble(
+    const LandscapeSoA& landscape, const std::vector<double>& density, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit,
+    size_t n_replicates, size_t batch_size = 64
+);
+
+// Number of fires with a size in [2^k, 2^(k+1)) cells for every k
+std::vector<size_t> fire_size_histogram(const std::vector<size_t>& fire_sizes);
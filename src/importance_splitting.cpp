@@ -0,0 +1,175 @@
+#include "importance_splitting.hpp"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include <omp.h>
+
+#include "reachable_region.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+namespace {
+
+struct Particle {
+  CpuFireState state;
+  double weight;
+  uint32_t max_distance; // farthest distance from the ignitions among its burned cells
+};
+
+} // namespace
+
+std::vector<uint32_t> ignition_distances(
+    size_t width, size_t height, const std::vector<std::pair<size_t, size_t>>& ignition_cells
+) {
+  const uint32_t far = UINT32_MAX - 1;
+  std::vector<uint32_t> dist(width * height, far);
+  for (auto [x, y] : ignition_cells) {
+    dist[utils::INDEX(x, y, width)] = 0;
+  }
+
+  // Two-pass chamfer transform with unit weights, exact for the Chebyshev distance
+  for (size_t j = 0; j < height; j++) {
+    for (size_t i = 0; i < width; i++) {
+      uint32_t& d = dist[utils::INDEX(i, j, width)];
+      if (i > 0) d = std::min(d, dist[utils::INDEX(i - 1, j, width)] + 1);
+      if (j > 0) {
+        d = std::min(d, dist[utils::INDEX(i, j - 1, width)] + 1);
+        if (i > 0) d = std::min(d, dist[utils::INDEX(i - 1, j - 1, width)] + 1);
+        if (i + 1 < width) d = std::min(d, dist[utils::INDEX(i + 1, j - 1, width)] + 1);
+      }
+    }
+  }
+  for (size_t j = height; j-- > 0;) {
+    for (size_t i = width; i-- > 0;) {
+      uint32_t& d = dist[utils::INDEX(i, j, width)];
+      if (i + 1 < width) d = std::min(d, dist[utils::INDEX(i + 1, j, width)] + 1);
+      if (j + 1 < height) {
+        d = std::min(d, dist[utils::INDEX(i, j + 1, width)] + 1);
+        if (i > 0) d = std::min(d, dist[utils::INDEX(i - 1, j + 1, width)] + 1);
+        if (i + 1 < width) d = std::min(d, dist[utils::INDEX(i + 1, j + 1, width)] + 1);
+      }
+    }
+  }
+  return dist;
+}
+
+SplittingEstimate estimate_rare_burn_probabilities(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_particles, size_t level_spacing, size_t split_factor,
+    size_t max_particles, uint64_t seed
+) {
+  if (n_particles == 0 || level_spacing == 0 || split_factor == 0 || max_particles == 0) {
+    throw std::runtime_error("Splitting needs positive particles, level spacing and split factor");
+  }
+
+  // Only the reachable region can burn, see burned_amounts_per_cell
+  CropWindow window = reachable_window(landscape, ignition_cells);
+  LandscapeSoA cropped = crop_landscape(landscape, window);
+  LandscapeView view = cropped.view();
+  std::vector<std::pair<size_t, size_t>> cropped_ignition_cells =
+      crop_ignition_cells(ignition_cells, window);
+  size_t n_cells = window.width * window.height;
+  // Terms of the cropped landscape, computed once for all the particles
+  DerivedLayers derived = DerivedLayers::compute(view, distance, elevation_mean, elevation_sd);
+  DerivedView derived_view = derived.view();
+
+  std::vector<uint32_t> dist = ignition_distances(window.width, window.height, cropped_ignition_cells);
+  uint32_t max_level = 0;
+  for (size_t idx = 0; idx < n_cells; idx++) {
+    if (cropped.burnable[idx] && dist[idx] != UINT32_MAX - 1) {
+      max_level = std::max<uint32_t>(max_level, dist[idx] / level_spacing);
+    }
+  }
+
+  int n_threads = omp_get_max_threads();
+  std::vector<std::vector<double>> sums(n_threads, std::vector<double>(n_cells, 0.0));
+  std::vector<size_t> steps(n_threads, 0);
+
+  std::vector<Particle> particles;
+  for (size_t p = 0; p < n_particles; p++) {
+    CpuFireState state = start_fire_cpu(view, cropped_ignition_cells, edge_bits(seed, p, 0));
+    particles.push_back({ std::move(state), 1.0 / n_particles, 0 });
+  }
+
+  SplittingEstimate estimate = {
+    Matrix<double>(landscape.width, landscape.height), {}, 0
+  };
+  std::mt19937_64 roulette(seed);
+
+  for (uint32_t level = 1; !particles.empty(); level++) {
+    TRACE_SPAN("splitting_level", "simulation", "level", level);
+    estimate.particles_per_level.push_back(particles.size());
+
+    // Past the last level no cell is farther, so the fires just run until they are extinguished
+    uint32_t threshold = level <= max_level ? level * level_spacing : UINT32_MAX;
+    std::vector<uint8_t> crossed(particles.size(), 0);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t p = 0; p < particles.size(); p++) {
+      Particle& particle = particles[p];
+      int thread = omp_get_thread_num();
+
+      while (particle.max_distance < threshold) {
+        size_t first_new = particle.state.burned_ids.size();
+        if (!advance_fire_step_cpu(particle.state, view, derived_view, params, upper_limit)) {
+          break;
+        }
+        steps[thread]++;
+        for (size_t b = first_new; b < particle.state.burned_ids.size(); b++) {
+          particle.max_distance = std::max(particle.max_distance, dist[particle.state.burned_ids[b]]);
+        }
+      }
+
+      if (particle.max_distance >= threshold) {
+        crossed[p] = 1;
+      } else {
+        std::vector<double>& sum = sums[thread];
+        for (size_t idx : particle.state.burned_ids) {
+          sum[idx] += particle.weight;
+        }
+      }
+    }
+
+    std::vector<Particle> next;
+    for (size_t p = 0; p < particles.size(); p++) {
+      if (!crossed[p]) {
+        continue;
+      }
+      for (size_t c = 0; c < split_factor; c++) {
+        Particle clone = c + 1 < split_factor ? particles[p] : std::move(particles[p]);
+        clone.weight /= split_factor;
+        clone.state.seed = edge_bits(clone.state.seed, level, c);
+        next.push_back(std::move(clone));
+      }
+    }
+
+    if (next.size() > max_particles) {
+      double keep = double(max_particles) / next.size();
+      std::bernoulli_distribution kept(keep);
+      std::vector<Particle> survivors;
+      for (Particle& particle : next) {
+        if (kept(roulette)) {
+          particle.weight /= keep;
+          survivors.push_back(std::move(particle));
+        }
+      }
+      next = std::move(survivors);
+    }
+    particles = std::move(next);
+  }
+
+  Matrix<double> cropped_probability(window.width, window.height);
+  for (size_t idx = 0; idx < n_cells; idx++) {
+    for (int t = 0; t < n_threads; t++) {
+      cropped_probability.elems[idx] += sums[t][idx];
+    }
+  }
+  add_cropped_amounts(estimate.probability, cropped_probability, window);
+  for (size_t s : steps) {
+    estimate.simulated_steps += s;
+  }
+  return estimate;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "landscape.hpp"
+#include "matrix.hpp"
+#include "spread_functions.cuh"
+
+/* Burn probabilities of cells that plain replicates rarely reach, by multilevel splitting.
+ *
+ * Levels are Chebyshev distances from the ignition cells: `level_spacing`, 2 * `level_spacing`,
+ * ... A fire (particle) is run on the host engine until it is extinguished, which adds its burned
+ * cells weighted by its weight to the estimate, or until one of its cells reaches the next level.
+ * Fires that reach a level are cloned `split_factor` times, each clone with a fraction of the
+ * weight and a new seed. The spread from a cell is only drawn when the cell is in the frontier, so
+ * reseeding gives every clone an independent future while sharing its past, and the weighted
+ * estimate stays unbiased. If a level has more than `max_particles` fires, each one is kept with
+ * probability max_particles / fires and its weight divided by that probability (also unbiased).
+ *
+ * Far cells are then resolved with a few hundred fires per level instead of the ~1 / probability
+ * replicates that plain Monte Carlo needs.
+ */
+
+struct SplittingEstimate {
+  Matrix<double> probability;
+  // Fires run to each level (index 0: the initial ones)
+  std::vector<size_t> particles_per_level;
+  // Spread steps simulated in total, a measure of the cost
+  size_t simulated_steps;
+};
+
+SplittingEstimate estimate_rare_burn_probabilities(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_particles, size_t level_spacing, size_t split_factor,
+    size_t max_particles, uint64_t seed
+);
+
+// Chebyshev distance (in cells) from every cell to the closest ignition cell
+std::vector<uint32_t> ignition_distances(
+    size_t width, size_t height, const std::vector<std::pair<size_t, size_t>>& ignition_cells
+);
@@ -0,0 +1,140 @@
+#include "incremental_ensemble.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "csv.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+std::vector<BurnableEdit> read_burnable_edits(std::string filename) {
+
+  std::ifstream file(filename);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("Can't open burnable edits file");
+  }
+
+  std::vector<BurnableEdit> edits;
+
+  CSVIterator loop(file);
+  loop++; // skip first line
+
+  for (; loop != CSVIterator(); ++loop) {
+    if (loop->size() < 3) {
+      throw std::runtime_error("Invalid burnable edits file");
+    }
+    edits.push_back({ size_t(atol((*loop)[0].data())), size_t(atol((*loop)[1].data())),
+                      uint8_t(atoi((*loop)[2].data()) != 0) });
+  }
+
+  file.close();
+
+  return edits;
+}
+
+IncrementalEnsemble::IncrementalEnsemble(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_replicates
+)
+    : landscape(landscape), ignition_cells(ignition_cells), params(params), distance(distance),
+      elevation_mean(elevation_mean), elevation_sd(elevation_sd), upper_limit(upper_limit),
+      burned_sets(n_replicates), amounts(landscape.width, landscape.height) {
+  TRACE_SPAN("build_incremental_ensemble", "simulation");
+
+  #pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < n_replicates; i++) {
+    burned_sets[i] = simulate_replicate(i);
+  }
+
+  for (const auto& burned : burned_sets) {
+    for (uint32_t idx : burned) {
+      amounts.elems[idx]++;
+    }
+  }
+}
+
+std::vector<uint32_t> IncrementalEnsemble::simulate_replicate(size_t replicate) const {
+  TRACE_SPAN("replicate", "simulation", "replicate", replicate);
+  LandscapeView view = landscape.view();
+  CpuFireState state = start_fire_cpu(view, ignition_cells, replicate_seed(replicate));
+  while (advance_fire_step_cpu(
+      state, view, params, distance, elevation_mean, elevation_sd, upper_limit
+  )) {
+  }
+  std::vector<uint32_t> burned(state.burned_ids.begin(), state.burned_ids.end());
+  std::sort(burned.begin(), burned.end());
+  return burned;
+}
+
+bool IncrementalEnsemble::is_affected(
+    const std::vector<uint32_t>& burned, const std::vector<BurnableEdit>& edits
+) const {
+  int width = landscape.width;
+  int height = landscape.height;
+  for (const BurnableEdit& edit : edits) {
+    if (std::binary_search(burned.begin(), burned.end(), utils::INDEX(edit.x, edit.y, width))) {
+      return true;
+    }
+    if (!edit.burnable) {
+      continue;
+    }
+    // A cell that becomes burnable changes the fire only if a burned neighbour can reach it
+    for (int n = 0; n < N_NEIGHBORS; n++) {
+      int ni = edit.x + MOVES[n][0];
+      int nj = edit.y + MOVES[n][1];
+      if (ni >= 0 && nj >= 0 && ni < width && nj < height &&
+          std::binary_search(burned.begin(), burned.end(), utils::INDEX(ni, nj, width))) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+size_t IncrementalEnsemble::apply_edits(const std::vector<BurnableEdit>& edits) {
+  TRACE_SPAN("apply_edits", "simulation");
+
+  std::vector<BurnableEdit> effective;
+  for (const BurnableEdit& edit : edits) {
+    if (edit.x >= landscape.width || edit.y >= landscape.height) {
+      throw std::runtime_error("Burnable edit outside of the landscape");
+    }
+    size_t idx = utils::INDEX(edit.x, edit.y, landscape.width);
+    if (landscape.burnable[idx] != edit.burnable) {
+      landscape.burnable[idx] = edit.burnable;
+      effective.push_back(edit);
+    }
+  }
+  if (effective.empty()) {
+    return 0;
+  }
+
+  std::vector<size_t> affected;
+  for (size_t i = 0; i < burned_sets.size(); i++) {
+    if (is_affected(burned_sets[i], effective)) {
+      affected.push_back(i);
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> updated(affected.size());
+  #pragma omp parallel for schedule(dynamic)
+  for (size_t a = 0; a < affected.size(); a++) {
+    updated[a] = simulate_replicate(affected[a]);
+  }
+
+  for (size_t a = 0; a < affected.size(); a++) {
+    std::vector<uint32_t>& burned = burned_sets[affected[a]];
+    for (uint32_t idx : burned) {
+      amounts.elems[idx]--;
+    }
+    for (uint32_t idx : updated[a]) {
+      amounts.elems[idx]++;
+    }
+    burned = std::move(updated[a]);
+  }
+
+  return affected.size();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+#include "matrix.hpp"
+#include "spread_functions.cuh"
+
+// Change of the `burnable` layer at cell (x, y), e.g. a fuel break sets it to 0
+struct BurnableEdit {
+  size_t x, y;
+  uint8_t burnable;
+};
+
+// Reads a csv file with a header line and one `x,y,burnable` edit per line
+std::vector<BurnableEdit> read_burnable_edits(std::string filename);
+
+/* Burn-probability ensemble that can be updated after editing the landscape.
+ *
+ * Replicates run on the host engine, whose draws only depend on (seed, cell, direction), so a
+ * replicate that never burned nor touched an edited cell would burn exactly the same cells after
+ * the edit. Each replicate keeps its burned set as sorted uint32 linear indices; `apply_edits`
+ * only re-simulates the replicates whose set contains an edited cell (or, for cells that become
+ * burnable, one of its neighbours) and patches `burned_amounts` with the difference.
+ */
+class IncrementalEnsemble {
+public:
+  IncrementalEnsemble(
+      const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+      SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+      float upper_limit, size_t n_replicates
+  );
+
+  // Returns the number of replicates that had to be re-simulated
+  size_t apply_edits(const std::vector<BurnableEdit>& edits);
+
+  const Matrix<size_t>& burned_amounts() const {
+    return amounts;
+  }
+
+  const LandscapeSoA& current_landscape() const {
+    return landscape;
+  }
+
+private:
+  std::vector<uint32_t> simulate_replicate(size_t replicate) const;
+  bool is_affected(const std::vector<uint32_t>& burned, const std::vector<BurnableEdit>& edits) const;
+
+  LandscapeSoA landscape;
+  std::vector<std::pair<size_t, size_t>> ignition_cells;
+  SimulationParams params;
+  float distance, elevation_mean, elevation_sd, upper_limit;
+
+  std::vector<std::vector<uint32_t>> burned_sets;
+  Matrix<size_t> amounts;
+};
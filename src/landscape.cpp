@@ -1,10 +1,13 @@
 #include "landscape.hpp"
 
 #include <fstream>
+#include <stdexcept>
 #include <cstddef>
 #include <string>
 #include <vector>
 
+#include "trace.hpp"
+
 LandscapeSoA::LandscapeSoA(size_t width, size_t height)
     : width(width), height(height),
       elevation(width * height),
@@ -14,8 +17,44 @@ LandscapeSoA::LandscapeSoA(size_t width, size_t height)
       wind_dir(width * height),
       burnable(width * height) {}
 
+LandscapeView LandscapeView::window(size_t x0, size_t y0, size_t width, size_t height) const {
+  if (x0 + width > this->width || y0 + height > this->height) {
+    throw std::runtime_error("Window out of the landscape");
+  }
+  size_t origin = y0 * row_stride() + x0;
+  return {
+    width, height, elevation + origin, fwi + origin, aspect + origin, vegetation_type + origin,
+    wind_dir + origin, burnable + origin, row_stride(),
+  };
+}
+
+void require_contiguous(const LandscapeView& landscape, const char* what) {
+  if (!landscape.contiguous()) {
+    throw std::runtime_error(
+        std::string(what) + " needs contiguous layers, copy the window with crop_landscape"
+    );
+  }
+}
+
+LandscapeView LandscapeSoA::view() const {
+  return {
+    width, height, elevation.data(), fwi.data(), aspect.data(), vegetation_type.data(),
+    wind_dir.data(), burnable.data()
+  };
+}
+
+size_t LandscapeSoA::bytes() const {
+  return bytes_for(width, height);
+}
+
+size_t LandscapeSoA::bytes_for(size_t width, size_t height) {
+  return width * height * (5 * sizeof(float) + sizeof(uint8_t));
+}
+
 LandscapeSoA::LandscapeSoA(std::string metadata_filename, std::string data_filename)
     : width(0), height(0) {
+  TRACE_SPAN("LandscapeSoA", "io");
+
   std::ifstream metadata_file(metadata_filename);
 
   if (!metadata_file.is_open()) {
@@ -74,4 +113,35 @@ LandscapeSoA::LandscapeSoA(std::string metadata_filename, std::string data_filen
   }
 
   landscape_file.close();
-}
\ No newline at end of file
+}
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint64_t landscape_hash(const LandscapeView& landscape) {
+  TRACE_SPAN("landscape_hash", "setup");
+  uint64_t size[2] = { landscape.width, landscape.height };
+  uint64_t hash = fnv1a(size, sizeof(size));
+  // Row by row, which hashes a window like a copy of it
+  auto hash_layer = [&](const auto* layer) {
+    size_t row_bytes = landscape.width * sizeof(*layer);
+    if (landscape.contiguous()) {
+      hash = fnv1a(layer, landscape.height * row_bytes, hash);
+      return;
+    }
+    for (size_t j = 0; j < landscape.height; j++) {
+      hash = fnv1a(layer + j * landscape.row_stride(), row_bytes, hash);
+    }
+  };
+  for (const float* layer : { landscape.elevation, landscape.fwi, landscape.aspect,
+                              landscape.vegetation_type, landscape.wind_dir }) {
+    hash_layer(layer);
+  }
+  hash_layer(landscape.burnable);
+  return hash;
+}
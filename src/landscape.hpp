@@ -14,6 +14,55 @@ enum VegetationType {
 
 static_assert( sizeof(VegetationType) == 1 );
 
+/* Non-owning view of the layers of a landscape, stored row-major: cell (x, y) is at y * stride + x
+ * of every layer. Used when the layers don't live in a LandscapeSoA, e.g. when mapped from shared
+ * memory, and for windows of a larger landscape (e.g. a regional mosaic) that share its layers.
+ *
+ * Cells, fires and results of a view are still indexed row-major over width x height (its linear
+ * index), only the layers are strided. The GPU engine, the reference host step and the functions
+ * that copy a landscape accept any stride. The host engines that read the layers with linear
+ * indices (derived layers, edge tables, multiple parameters) need contiguous layers and throw
+ * otherwise; copy the window with `crop_landscape` first.
+ */
+struct LandscapeView {
+  size_t width, height;
+
+  const float* elevation;
+  const float* fwi;
+  const float* aspect;
+  const float* vegetation_type;
+  const float* wind_dir;
+  const uint8_t* burnable;
+
+  // Cells between the starts of consecutive rows of the layers, 0 for `width`
+  size_t stride = 0;
+
+  size_t row_stride() const {
+    return stride ? stride : width;
+  }
+
+  bool contiguous() const {
+    return row_stride() == width;
+  }
+
+  // Position in the layers of the cell with linear index `idx`
+  size_t layer_index(size_t idx) const {
+    return contiguous() ? idx : idx / width * row_stride() + idx % width;
+  }
+
+  // Window [x0, x0 + width) x [y0, y0 + height) of this view, without copying the layers
+  LandscapeView window(size_t x0, size_t y0, size_t width, size_t height) const;
+};
+
+// Throws unless the layers of `landscape` are contiguous, for the engines that need them
+void require_contiguous(const LandscapeView& landscape, const char* what);
+
+// 64-bit FNV-1a hash of `size` bytes, continuing from `hash`
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL);
+
+// Hash of the size and every layer of a landscape, identifies its content in on-disk caches
+uint64_t landscape_hash(const LandscapeView& landscape);
+
 struct LandscapeSoA {
   size_t width, height;
 
@@ -28,6 +77,10 @@ struct LandscapeSoA {
   LandscapeSoA(std::string metadata_filename, std::string data_filename);
 
   ~LandscapeSoA() = default;
-};
 
+  LandscapeView view() const;
 
+  // Bytes taken by the layers, of this landscape or of one of the given size
+  size_t bytes() const;
+  static size_t bytes_for(size_t width, size_t height);
+};
@@ -0,0 +1,80 @@
+#include "landscape_cache.hpp"
+
+#include "trace.hpp"
+
+size_t PreparedLandscape::bytes() const {
+  return layers.bytes() + derived.bytes();
+}
+
+LandscapeCache::LandscapeCache(
+    size_t memory_cap, float distance, float elevation_mean, float elevation_sd
+)
+    : memory_cap(memory_cap), distance(distance), elevation_mean(elevation_mean),
+      elevation_sd(elevation_sd) {}
+
+std::shared_ptr<const PreparedLandscape> LandscapeCache::get(const std::string& prefix) {
+  std::promise<std::shared_ptr<const PreparedLandscape>> loaded;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(prefix);
+    if (it != entries.end()) {
+      hits++;
+      order.splice(order.begin(), order, it->second.position);
+      return it->second.landscape;
+    }
+    auto pending = loading.find(prefix);
+    if (pending != loading.end()) {
+      // Being loaded by another thread, wait for it
+      hits++;
+      std::shared_future<std::shared_ptr<const PreparedLandscape>> result = pending->second;
+      lock.unlock();
+      return result.get();
+    }
+    misses++;
+    loading[prefix] = loaded.get_future().share();
+  }
+
+  // Loaded without the lock, so requests for other landscapes are not held up
+  std::shared_ptr<PreparedLandscape> landscape;
+  try {
+    TRACE_SPAN("load_landscape", "io");
+    LandscapeSoA layers(prefix + "-metadata.csv", prefix + "-landscape.csv");
+    DerivedLayers derived = DerivedLayers::open_or_build(
+        layers.view(), prefix + "-derived.bin", distance, elevation_mean, elevation_sd
+    );
+    landscape = std::make_shared<PreparedLandscape>(
+        PreparedLandscape{ std::move(layers), std::move(derived) }
+    );
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      loading.erase(prefix);
+    }
+    loaded.set_exception(std::current_exception());
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    loading.erase(prefix);
+    order.push_front(prefix);
+    entries[prefix] = { landscape, order.begin() };
+    bytes += landscape->bytes();
+
+    // The landscape just loaded is kept even if it alone is over the cap
+    while (bytes > memory_cap && order.size() > 1) {
+      auto evicted = entries.find(order.back());
+      bytes -= evicted->second.landscape->bytes();
+      entries.erase(evicted);
+      order.pop_back();
+      evictions++;
+    }
+  }
+  loaded.set_value(landscape);
+  return landscape;
+}
+
+LandscapeCache::Stats LandscapeCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return { hits, misses, evictions, entries.size(), bytes };
+}
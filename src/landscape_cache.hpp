@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "derived_layers.hpp"
+#include "landscape.hpp"
+
+// A landscape ready for the host engine: its layers and their derived terms
+struct PreparedLandscape {
+  LandscapeSoA layers;
+  DerivedLayers derived;
+
+  size_t bytes() const;
+};
+
+/* Prepared landscapes of a long-running process, by file prefix, evicting the least recently used
+ * ones once they take more than `memory_cap` bytes. Derived layers are read from (or written to)
+ * the `<prefix>-derived.bin` sidecar, see derived_layers.hpp.
+ *
+ * Landscapes are handed out as shared pointers, so an evicted landscape stays alive until the
+ * requests using it finish. Thread-safe, and a landscape is loaded once: threads asking for a
+ * landscape that another thread is loading wait for it (and get its error if the load fails).
+ */
+class LandscapeCache {
+public:
+  LandscapeCache(size_t memory_cap, float distance, float elevation_mean, float elevation_sd);
+
+  std::shared_ptr<const PreparedLandscape> get(const std::string& prefix);
+
+  struct Stats {
+    size_t hits, misses, evictions;
+    size_t n_landscapes, bytes;
+  };
+
+  Stats stats();
+
+private:
+  struct Entry {
+    std::shared_ptr<const PreparedLandscape> landscape;
+    std::list<std::string>::iterator position;
+  };
+
+  size_t memory_cap;
+  float distance, elevation_mean, elevation_sd;
+
+  std::mutex mutex;
+  // Most recently used first
+  std::list<std::string> order;
+  std::unordered_map<std::string, Entry> entries;
+  // Landscapes being loaded, without the lock, by the thread that missed them first
+  std::unordered_map<std::string, std::shared_future<std::shared_ptr<const PreparedLandscape>>>
+      loading;
+  size_t bytes = 0;
+  size_t hits = 0, misses = 0, evictions = 0;
+};
@@ -0,0 +1,220 @@
+#include "landscape_pyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "burn_estimator.hpp"
+#include "trace.hpp"
+
+LandscapeSoA coarsen_landscape(const LandscapeSoA& landscape, size_t factor) {
+  if (factor == 0) {
+    throw std::runtime_error("The coarsening factor must be positive");
+  }
+  TRACE_SPAN("coarsen_landscape", "setup", "factor", factor);
+  size_t width = (landscape.width + factor - 1) / factor;
+  size_t height = (landscape.height + factor - 1) / factor;
+  LandscapeSoA coarse(width, height);
+
+  #pragma omp parallel for schedule(static)
+  for (size_t cj = 0; cj < height; cj++) {
+    for (size_t ci = 0; ci < width; ci++) {
+      size_t x_end = std::min((ci + 1) * factor, landscape.width);
+      size_t y_end = std::min((cj + 1) * factor, landscape.height);
+
+      double elevation = 0, fwi = 0, aspect = 0, wind_sin = 0, wind_cos = 0;
+      size_t n_cells = 0, n_burnable = 0;
+      size_t vegetation_counts[DRY + 1] = {};
+      for (size_t y = cj * factor; y < y_end; y++) {
+        for (size_t x = ci * factor; x < x_end; x++) {
+          size_t idx = y * landscape.width + x;
+          elevation += landscape.elevation[idx];
+          fwi += landscape.fwi[idx];
+          aspect += landscape.aspect[idx];
+          wind_sin += std::sin(landscape.wind_dir[idx]);
+          wind_cos += std::cos(landscape.wind_dir[idx]);
+          n_cells++;
+          if (landscape.burnable[idx]) {
+            n_burnable++;
+            int vegetation = landscape.vegetation_type[idx];
+            if (vegetation >= MATORRAL && vegetation <= DRY) {
+              vegetation_counts[vegetation]++;
+            }
+          }
+        }
+      }
+
+      size_t idx = cj * width + ci;
+      coarse.elevation[idx] = elevation / n_cells;
+      coarse.fwi[idx] = fwi / n_cells;
+      coarse.aspect[idx] = aspect / n_cells;
+      coarse.wind_dir[idx] = std::atan2(wind_sin, wind_cos);
+      coarse.vegetation_type[idx] =
+          std::max_element(vegetation_counts, vegetation_counts + DRY + 1) - vegetation_counts;
+      coarse.burnable[idx] = 2 * n_burnable >= n_cells;
+    }
+  }
+  return coarse;
+}
+
+std::vector<std::pair<size_t, size_t>> coarsen_ignition_cells(
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, size_t factor
+) {
+  std::vector<std::pair<size_t, size_t>> coarse;
+  for (auto [x, y] : ignition_cells) {
+    std::pair<size_t, size_t> cell = { x / factor, y / factor };
+    if (std::find(coarse.begin(), coarse.end(), cell) == coarse.end()) {
+      coarse.push_back(cell);
+    }
+  }
+  return coarse;
+}
+
+namespace {
+
+constexpr float MAX_INTERCEPT_SHIFT = 10.0f;
+constexpr int CALIBRATION_STEPS = 10;
+
+// Cells of the landscape expected to burn with the probabilities of `coarse`, each coarse cell
+// standing for the burnable cells of its block
+double burned_area(const Matrix<double>& probability, const std::vector<size_t>& block_burnable) {
+  double area = 0;
+  for (size_t idx = 0; idx < block_burnable.size(); idx++) {
+    area += probability.elems[idx] * block_burnable[idx];
+  }
+  return area;
+}
+
+} // namespace
+
+SimulationParams calibrate_coarse_params(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    const LandscapeSoA& coarse, const std::vector<std::pair<size_t, size_t>>& coarse_ignition_cells,
+    size_t factor, SimulationParams params, float distance, float elevation_mean,
+    float elevation_sd, float upper_limit, size_t n_pilot
+) {
+  if (factor == 1) {
+    return params;
+  }
+  TRACE_SPAN("calibrate_coarse_params", "simulation", "factor", factor);
+
+  std::vector<size_t> block_burnable(coarse.width * coarse.height, 0);
+  for (size_t y = 0; y < landscape.height; y++) {
+    for (size_t x = 0; x < landscape.width; x++) {
+      block_burnable[(y / factor) * coarse.width + x / factor] +=
+          landscape.burnable[y * landscape.width + x];
+    }
+  }
+
+  double target = burned_area(
+      estimate_burn_probabilities(
+          landscape, ignition_cells, params, distance, elevation_mean, elevation_sd, upper_limit,
+          EdgeStream::INDEPENDENT, n_pilot, 1
+      ).probability,
+      std::vector<size_t>(landscape.burnable.begin(), landscape.burnable.end())
+  );
+
+  float low = -MAX_INTERCEPT_SHIFT, high = MAX_INTERCEPT_SHIFT;
+  for (int step = 0; step < CALIBRATION_STEPS; step++) {
+    SimulationParams shifted = params;
+    shifted.independent_pred += (low + high) / 2;
+    double area = burned_area(
+        estimate_burn_probabilities(
+            coarse, coarse_ignition_cells, shifted, distance * factor, elevation_mean,
+            elevation_sd, upper_limit, EdgeStream::INDEPENDENT, n_pilot, 1
+        ).probability,
+        block_burnable
+    );
+    (area < target ? low : high) = (low + high) / 2;
+  }
+  params.independent_pred += (low + high) / 2;
+  return params;
+}
+
+BurnProbabilityPreview preview_burn_probabilities(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t level, size_t n_replicates, double refine_threshold, size_t n_pilot
+) {
+  // A block must be smaller than the landscape, which also keeps the shift in range
+  size_t min_side = std::min(landscape.width, landscape.height);
+  if (level > 0 && (level >= std::numeric_limits<size_t>::digits || pyramid_factor(level) >= min_side)) {
+    throw std::runtime_error(
+        "Pyramid level " + std::to_string(level) + " is too coarse for a " +
+        std::to_string(landscape.width) + "x" + std::to_string(landscape.height) + " landscape"
+    );
+  }
+  size_t factor = pyramid_factor(level);
+  BurnProbabilityPreview preview = {
+    Matrix<double>(landscape.width, landscape.height), factor, n_replicates, 0.0f, std::nullopt
+  };
+
+  LandscapeSoA coarse = coarsen_landscape(landscape, factor);
+  std::vector<std::pair<size_t, size_t>> coarse_ignition_cells =
+      coarsen_ignition_cells(ignition_cells, factor);
+  for (auto [x, y] : coarse_ignition_cells) {
+    coarse.burnable[y * coarse.width + x] = 1; // the fire starts even in a mostly unburnable block
+  }
+
+  SimulationParams shifted = params;
+  if (n_pilot > 0) {
+    shifted = calibrate_coarse_params(
+        landscape, ignition_cells, coarse, coarse_ignition_cells, factor, params, distance,
+        elevation_mean, elevation_sd, upper_limit, n_pilot
+    );
+  }
+  preview.intercept_shift = shifted.independent_pred - params.independent_pred;
+
+  BurnProbabilityEstimate coarse_estimate = estimate_burn_probabilities(
+      coarse, coarse_ignition_cells, shifted, distance * factor, elevation_mean, elevation_sd, upper_limit, EdgeStream::INDEPENDENT,
+      n_replicates, 1
+  );
+
+  size_t x_min = landscape.width, y_min = landscape.height, x_max = 0, y_max = 0;
+  for (size_t y = 0; y < landscape.height; y++) {
+    for (size_t x = 0; x < landscape.width; x++) {
+      double p = landscape.burnable[y * landscape.width + x]
+                     ? coarse_estimate.probability[{ x / factor, y / factor }]
+                     : 0.0;
+      preview.probability[{ x, y }] = p;
+      if (refine_threshold > 0 && p >= refine_threshold) {
+        x_min = std::min(x_min, x);
+        y_min = std::min(y_min, y);
+        x_max = std::max(x_max, x);
+        y_max = std::max(y_max, y);
+      }
+    }
+  }
+  if (refine_threshold <= 0 || factor == 1) {
+    return preview;
+  }
+
+  TRACE_SPAN("refine_preview", "simulation");
+  for (auto [x, y] : ignition_cells) {
+    x_min = std::min(x_min, x);
+    y_min = std::min(y_min, y);
+    x_max = std::max(x_max, x);
+    y_max = std::max(y_max, y);
+  }
+  if (x_min > x_max) {
+    return preview; // nothing above the threshold and no ignitions
+  }
+  x_min = x_min > factor ? x_min - factor : 0;
+  y_min = y_min > factor ? y_min - factor : 0;
+  x_max = std::min(x_max + factor, landscape.width - 1);
+  y_max = std::min(y_max + factor, landscape.height - 1);
+  CropWindow window = { x_min, y_min, x_max - x_min + 1, y_max - y_min + 1 };
+
+  BurnProbabilityEstimate refined = estimate_burn_probabilities(
+      crop_landscape(landscape, window), crop_ignition_cells(ignition_cells, window), params,
+      distance, elevation_mean, elevation_sd, upper_limit, EdgeStream::INDEPENDENT, n_replicates, 1
+  );
+  for (size_t j = 0; j < window.height; j++) {
+    for (size_t i = 0; i < window.width; i++) {
+      preview.probability[{ window.x0 + i, window.y0 + j }] = refined.probability[{ i, j }];
+    }
+  }
+  preview.refined = window;
+  return preview;
+}
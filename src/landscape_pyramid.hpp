@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "landscape.hpp"
+#include "matrix.hpp"
+#include "reachable_region.hpp"
+#include "spread_functions.cuh"
+
+/* Coarser versions of a landscape for quick previews of burn probabilities.
+ *
+ * A cell of a level `factor` times coarser covers a factor x factor block of the original (less on
+ * the right and bottom borders). It is burnable if at least half of the block is, its vegetation is
+ * the most common among the burnable cells of the block (ties to the lowest type), its elevation,
+ * fwi and aspect are the means of the block and its wind direction the circular mean.
+ */
+LandscapeSoA coarsen_landscape(const LandscapeSoA& landscape, size_t factor);
+
+// Factor of pyramid level `level`: level k is 2^k times coarser, level 0 being the landscape
+inline size_t pyramid_factor(size_t level) {
+  return size_t(1) << level;
+}
+
+// Ignition cells in the coordinates of a level `factor` times coarser, without repetitions
+std::vector<std::pair<size_t, size_t>> coarsen_ignition_cells(
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, size_t factor
+);
+
+/* Parameters for simulating on `coarse`, a level `factor` times coarser than `landscape` (the
+ * distance between its cells is `factor * distance`, which rescales the slopes).
+ *
+ * How the spread probabilities must change with the cell size depends on how close the fire is to
+ * the threshold between dying out and spreading, so they are calibrated: the intercept is shifted
+ * until the mean burned area (in cells of `landscape`) of `n_pilot` replicates on the coarse level
+ * matches that of `n_pilot` replicates at full resolution. Replicates with the same seed share
+ * their draws in the host engine, so the coarse area only grows with the shift and a bisection
+ * finds it.
+ */
+SimulationParams calibrate_coarse_params(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    const LandscapeSoA& coarse, const std::vector<std::pair<size_t, size_t>>& coarse_ignition_cells,
+    size_t factor, SimulationParams params, float distance, float elevation_mean,
+    float elevation_sd, float upper_limit, size_t n_pilot
+);
+
+struct BurnProbabilityPreview {
+  // At the resolution of the landscape
+  Matrix<double> probability;
+  size_t factor;
+  size_t n_replicates;
+  // Added to the intercept on the coarse level, see `calibrate_coarse_params`
+  float intercept_shift;
+  // Region simulated again at full resolution, if any
+  std::optional<CropWindow> refined;
+};
+
+/* Burn probabilities estimated with `n_replicates` plain Monte Carlo replicates on pyramid level
+ * `level`, spread back to the burnable cells of the landscape. Throws unless the blocks of the level
+ * are smaller than both sides of the landscape.
+ *
+ * The coarse parameters are calibrated with `n_pilot` replicates by `calibrate_coarse_params`
+ * first: without it the coarse fires burn far too much (more the coarser the level). With
+ * `n_pilot` = 0 only the distance is rescaled, which is only useful to compare with the calibrated
+ * preview.
+ *
+ * With `refine_threshold` > 0, the bounding box of the cells with a preview probability of at
+ * least `refine_threshold` (and of the ignition cells), plus one coarse cell around it, is
+ * simulated again at full resolution and replaces the preview there. Fires in that window can't
+ * leave it, which only matters if the preview underestimated the cells around it.
+ */
+BurnProbabilityPreview preview_burn_probabilities(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t level, size_t n_replicates, double refine_threshold = 0,
+    size_t n_pilot = 32
+);
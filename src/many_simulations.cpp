@@ -2,51 +2,316 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstdio>
 #include <fstream>
 #include <algorithm>
 #include <numeric>
+#include <memory>
 #include "fires.hpp"
+#include "memory_accounting.hpp"
+#include "reachable_region.hpp"
+#include "result_cache.hpp"
+#include "shared_landscape.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define PERF_FILENAME "graphics/simdata/burned_probabilities_perf_data_"
 
-Matrix<size_t> burned_amounts_per_cell(
-    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
-    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
-    float upper_limit, size_t n_replicates, std::string output_filename_suffix
+Matrix<size_t> simulate_burned_amounts(
+    const LandscapeView& landscape, const CropWindow& window,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit,
+    size_t n_replicates, EnsemblePerf& perf, FireArchiveWriter* archive, size_t first_replicate,
+    const CheckpointOptions* checkpoint
 ) {
-  size_t n_col = landscape.width;
-  size_t n_row = landscape.height;
+  LandscapeView cropped_view = window_view(landscape, window);
+  std::vector<std::pair<size_t, size_t>> cropped_ignition_cells =
+      crop_ignition_cells(ignition_cells, window);
+
+  size_t n_col = window.width;
+  size_t n_row = window.height;
 
-  Matrix<size_t> burned_amounts(n_col, n_row);
+  Matrix<size_t> cropped_amounts(n_col, n_row);
+  MemoryUsage amounts_usage(
+      MemoryComponent::ACCUMULATORS, cropped_amounts.elems.size() * sizeof(size_t)
+  );
   float max_metric = 0.0f;
   float total_time_taken = 0.0f;
 
-  for (size_t i = 0; i < n_replicates; i++) {
-    Fire fire = simulate_fire(
-      landscape, n_row, n_col, ignition_cells, params,
-      distance, elevation_mean, elevation_sd, i, upper_limit
+  size_t next_replicate = first_replicate;
+  std::unique_ptr<CheckpointWriter> checkpointer;
+  if (checkpoint) {
+    // The configuration of the result cache, plus the replicates of this ensemble
+    std::string configuration = ResultCache::key(
+        landscape_hash(landscape), ignition_cells, params, distance, elevation_mean,
+        elevation_sd, upper_limit
+    );
+    size_t range[2] = { first_replicate, n_replicates };
+    uint64_t key = fnv1a(range, sizeof(range), fnv1a(configuration.data(), configuration.size()));
+
+    if (checkpoint->resume) {
+      std::optional<EnsembleCheckpoint> saved =
+          read_checkpoint(checkpoint->filename, key, cropped_amounts.elems.size());
+      if (saved) {
+        next_replicate = saved->next_replicate;
+        max_metric = saved->max_metric;
+        total_time_taken = saved->total_time_taken;
+        cropped_amounts.elems = std::move(saved->burned_amounts);
+        std::cout << "* Resuming from replicate " << next_replicate << std::endl;
+      }
+    }
+    checkpointer = std::make_unique<CheckpointWriter>(
+        checkpoint->filename, key, checkpoint->interval_seconds
+    );
+  }
+
+  // Reused by every replicate, its buffers only grow up to the size of the largest fire
+  Fire fire = empty_fire(n_col, n_row);
+  MemoryUsage fire_usage(MemoryComponent::FIRE_BUFFERS);
+
+  for (size_t i = next_replicate; i < first_replicate + n_replicates; i++) {
+    TRACE_SPAN("replicate", "simulation", "replicate", i);
+    simulate_fire(
+      cropped_view, cropped_ignition_cells, params,
+      distance, elevation_mean, elevation_sd, i, upper_limit, fire
     );
+    fire_usage.set(fire.capacity_bytes());
 
     float metric = fire.processed_cells / (fire.time_taken * 1e6);
     
     max_metric = std::max(max_metric, metric);
     total_time_taken += fire.time_taken;
 
-    for (size_t col = 0; col < n_col; col++) {
-      for (size_t row = 0; row < n_row; row++) {
-        if (fire.burned_layer[utils::INDEX(col, row, n_col)]) {
-          burned_amounts[{col, row}] += 1;
-        }
+    TRACE_SPAN("accumulate", "results");
+    for (uint32_t idx : fire.burned_cells) {
+      cropped_amounts.elems[idx]++;
+    }
+
+    if (archive) {
+      ArchivedFire archived = archived_fire(fire, i, replicate_seed(i), params);
+      for (uint32_t& idx : archived.burned_cells) {
+        idx = utils::INDEX(window.x0 + idx % n_col, window.y0 + idx / n_col, landscape.width);
       }
+      archive->append(std::move(archived));
+    }
+
+    if (checkpointer) {
+      checkpointer->offer(i + 1, max_metric, total_time_taken, cropped_amounts.elems);
     }
   }
 
+  if (checkpointer) {
+    // A finished ensemble has nothing to resume. A failed checkpoint doesn't invalidate the
+    // counts, but then the file on disk may be stale or missing, so it is left alone
+    try {
+      checkpointer->close();
+      std::remove(checkpoint->filename.c_str());
+    } catch (const std::runtime_error& e) {
+      std::cerr << "WARNING: " << e.what() << std::endl;
+    }
+  }
+
+  Matrix<size_t> burned_amounts(landscape.width, landscape.height);
+  amounts_usage.set((cropped_amounts.elems.size() + burned_amounts.elems.size()) * sizeof(size_t));
+  add_cropped_amounts(burned_amounts, cropped_amounts, window);
+
+  perf.n_replicates += n_replicates;
+  perf.max_metric = std::max(perf.max_metric, max_metric);
+  perf.total_time_taken += total_time_taken;
+  return burned_amounts;
+}
+
+void report_ensemble_perf(
+    const EnsemblePerf& perf, size_t n_cells, std::string output_filename_suffix
+) {
   // Guardamos data de la performance para graficar
+  TRACE_SPAN("write_perf_data", "output");
   std::ofstream outputFile(PERF_FILENAME + output_filename_suffix + ".txt", std::ios::app);
-  outputFile << "1, " << n_col * n_row << ", " << max_metric << ", " << total_time_taken << std::endl;
+  outputFile << "1, " << n_cells << ", " << perf.max_metric << ", " << perf.total_time_taken << std::endl;
   outputFile.close();
 
   std::cout << "  SIMULATION PERFORMANCE DATA" << std::endl;
+  std::cout << "* Total time taken: " << perf.total_time_taken << " seconds" << std::endl;
+  std::cout << "* Average time per simulation: " << perf.total_time_taken / perf.n_replicates << " seconds" << std::endl;
+  std::cout << "* Max metric: " << perf.max_metric << " cells/nanosec processed" << std::endl;
+}
+
+Matrix<size_t> burned_amounts_per_cell(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_replicates, std::string output_filename_suffix,
+    FireArchiveWriter* archive, size_t first_replicate, const CheckpointOptions* checkpoint
+) {
+  // Only the region reachable from the ignition cells can burn, so simulate on its bounding box
+  CropWindow window = reachable_window(landscape, ignition_cells);
+  EnsemblePerf perf;
+  Matrix<size_t> burned_amounts = simulate_burned_amounts(
+      landscape, window, ignition_cells, params, distance, elevation_mean, elevation_sd,
+      upper_limit, n_replicates, perf, archive, first_replicate, checkpoint
+  );
+  report_ensemble_perf(perf, landscape.width * landscape.height, output_filename_suffix);
+  return burned_amounts;
+}
+
+Matrix<size_t> burned_amounts_per_cell(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_replicates, std::string output_filename_suffix,
+    FireArchiveWriter* archive, size_t first_replicate, const CheckpointOptions* checkpoint
+) {
+  return burned_amounts_per_cell(
+      landscape.view(), ignition_cells, params, distance, elevation_mean, elevation_sd,
+      upper_limit, n_replicates, output_filename_suffix, archive, first_replicate, checkpoint
+  );
+}
+
+namespace {
+
+// Written by each worker into its own slot of a shared mapping
+struct WorkerStats {
+  float max_metric;
+  float total_time_taken;
+};
+
+template <typename T> T* map_shared_anonymous(size_t n) {
+  void* ptr = mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    throw std::runtime_error("Can't map shared accumulator");
+  }
+  return static_cast<T*>(ptr);
+}
+
+void run_worker(
+    const std::string& segment_name, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t first_replicate, size_t last_replicate, size_t* burned_amounts,
+    WorkerStats* stats
+) {
+  SharedLandscape shared = SharedLandscape::open(segment_name);
+  LandscapeView landscape = shared.view();
+  Fire fire = empty_fire(landscape.width, landscape.height);
+
+  for (size_t i = first_replicate; i < last_replicate; i++) {
+    TRACE_SPAN("replicate", "simulation", "replicate", i);
+    simulate_fire(
+      landscape, ignition_cells, params, distance, elevation_mean, elevation_sd, i, upper_limit,
+      fire
+    );
+
+    float metric = fire.processed_cells / (fire.time_taken * 1e6);
+    stats->max_metric = std::max(stats->max_metric, metric);
+    stats->total_time_taken += fire.time_taken;
+
+    TRACE_SPAN("accumulate", "results");
+    for (uint32_t idx : fire.burned_cells) {
+      __atomic_fetch_add(&burned_amounts[idx], 1, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// Kills and reaps the workers already started, when the others can't be
+void stop_workers(const std::vector<pid_t>& workers) {
+  for (pid_t pid : workers) {
+    kill(pid, SIGKILL);
+  }
+  for (pid_t pid : workers) {
+    waitpid(pid, nullptr, 0);
+  }
+}
+
+} // namespace
+
+Matrix<size_t> burned_amounts_per_cell_multiprocess(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_replicates, size_t n_workers, std::string output_filename_suffix
+) {
+  // Only the reachable window is placed in shared memory, see burned_amounts_per_cell
+  CropWindow window = reachable_window(landscape, ignition_cells);
+  std::vector<std::pair<size_t, size_t>> cropped_ignition_cells =
+      crop_ignition_cells(ignition_cells, window);
+
+  size_t n_col = window.width;
+  size_t n_row = window.height;
+  size_t n_cells = n_col * n_row;
+
+  SharedLandscape shared = SharedLandscape::create(
+      crop_landscape(landscape, window), "/fire_spread_" + std::to_string(getpid())
+  );
+  size_t* shared_amounts = map_shared_anonymous<size_t>(n_cells);
+  WorkerStats* stats = map_shared_anonymous<WorkerStats>(n_workers);
+
+  std::vector<pid_t> workers;
+  for (size_t w = 0; w < n_workers; w++) {
+    size_t first_replicate = w * n_replicates / n_workers;
+    size_t last_replicate = (w + 1) * n_replicates / n_workers;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      stop_workers(workers);
+      munmap(shared_amounts, n_cells * sizeof(size_t));
+      munmap(stats, n_workers * sizeof(WorkerStats));
+      throw std::runtime_error("Can't fork simulation worker");
+    }
+    if (pid == 0) {
+      // The child never unwinds into the parent's frames: their destructors would unlink the
+      // shared segment the other workers still read
+      int status = EXIT_FAILURE;
+      try {
+        run_worker(
+          shared.name(), cropped_ignition_cells, params, distance, elevation_mean, elevation_sd,
+          upper_limit, first_replicate, last_replicate, shared_amounts, &stats[w]
+        );
+        status = EXIT_SUCCESS;
+      } catch (std::exception& e) {
+        std::cerr << "ERROR (worker " << w << "): " << e.what() << std::endl;
+      } catch (...) {
+        std::cerr << "ERROR (worker " << w << "): unknown exception" << std::endl;
+      }
+      // Skip destructors and atexit handlers inherited from the parent
+      _exit(status);
+    }
+    workers.push_back(pid);
+  }
+
+  bool failed = false;
+  for (pid_t pid : workers) {
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed = true;
+    }
+  }
+
+  Matrix<size_t> cropped_amounts(n_col, n_row);
+  std::copy(shared_amounts, shared_amounts + n_cells, cropped_amounts.elems.begin());
+  Matrix<size_t> burned_amounts(landscape.width, landscape.height);
+  add_cropped_amounts(burned_amounts, cropped_amounts, window);
+
+  float max_metric = 0.0f;
+  float total_time_taken = 0.0f;
+  for (size_t w = 0; w < n_workers; w++) {
+    max_metric = std::max(max_metric, stats[w].max_metric);
+    total_time_taken += stats[w].total_time_taken;
+  }
+
+  munmap(shared_amounts, n_cells * sizeof(size_t));
+  munmap(stats, n_workers * sizeof(WorkerStats));
+
+  if (failed) {
+    throw std::runtime_error("A simulation worker failed");
+  }
+
+  // Guardamos data de la performance para graficar
+  std::ofstream outputFile(PERF_FILENAME + output_filename_suffix + ".txt", std::ios::app);
+  outputFile << n_workers << ", " << landscape.width * landscape.height << ", " << max_metric << ", " << total_time_taken << std::endl;
+  outputFile.close();
+
+  std::cout << "  SIMULATION PERFORMANCE DATA (" << n_workers << " processes)" << std::endl;
   std::cout << "* Total time taken: " << total_time_taken << " seconds" << std::endl;
   std::cout << "* Average time per simulation: " << total_time_taken / n_replicates << " seconds" << std::endl;
   std::cout << "* Max metric: " << max_metric << " cells/nanosec processed" << std::endl;
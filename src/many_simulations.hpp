@@ -2,15 +2,75 @@
 
 #include <vector>
 
+#include "checkpoint.hpp"
+#include "fire_archive.hpp"
 #include "fires.hpp"
 #include "landscape.hpp"
+#include "reachable_region.hpp"
 #include "spread_functions.cuh"
 
 /* Make `n_replicates` simulation and return a matrix with the number of simulations each cell
- * was burned.
+ * was burned. If `archive` is given, every fire is also appended to it. The replicates (and so
+ * their seeds) are `first_replicate`, `first_replicate + 1`, ...
+ *
+ * If `checkpoint` is given, the amounts are checkpointed periodically to its file (which is removed
+ * once the ensemble finishes), and with `resume` the ensemble continues from that file if it exists.
+ * A resumed ensemble doesn't append the fires simulated before the checkpoint to `archive`.
+ *
+ * The fires are simulated on a window of `landscape` around the region reachable from the ignition
+ * cells, a view that shares its layers, so a large landscape (e.g. a regional mosaic) is never
+ * copied. The result and the archived fires are in the coordinates of `landscape`.
  */
 Matrix<size_t> burned_amounts_per_cell(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_replicates, std::string output_filename_suffix,
+    FireArchiveWriter* archive = nullptr, size_t first_replicate = 0,
+    const CheckpointOptions* checkpoint = nullptr
+);
+Matrix<size_t> burned_amounts_per_cell(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit, size_t n_replicates, std::string output_filename_suffix,
+    FireArchiveWriter* archive = nullptr, size_t first_replicate = 0,
+    const CheckpointOptions* checkpoint = nullptr
+);
+
+// Timing of the replicates of an ensemble, reported by `report_ensemble_perf`
+struct EnsemblePerf {
+  size_t n_replicates = 0;
+  float max_metric = 0.0f;
+  float total_time_taken = 0.0f;
+};
+
+/* The replicates of `burned_amounts_per_cell` on `window`, which must be the `reachable_window` of
+ * `landscape` and the ignition cells. Nothing is printed or written to the perf file, the timing is
+ * added to `perf` instead, so a caller that runs several batches (see
+ * `cached_burned_amounts_per_cell`) finds the window once and reports once.
+ */
+Matrix<size_t> simulate_burned_amounts(
+    const LandscapeView& landscape, const CropWindow& window,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit,
+    size_t n_replicates, EnsemblePerf& perf, FireArchiveWriter* archive = nullptr,
+    size_t first_replicate = 0, const CheckpointOptions* checkpoint = nullptr
+);
+
+// Appends `perf` to the perf file of `output_filename_suffix` and prints it
+void report_ensemble_perf(
+    const EnsemblePerf& perf, size_t n_cells, std::string output_filename_suffix
+);
+
+/* Same as `burned_amounts_per_cell`, but the landscape is loaded once into a POSIX shared-memory
+ * segment and the replicates are split among `n_workers` forked processes that map it read-only.
+ * Workers add their burned cells to an accumulator that is also shared, so the result is identical
+ * to the single-process one (replicate i always uses the same seed).
+ *
+ * CUDA must not be initialized in the calling process before this is called, every worker creates
+ * its own context after the fork.
+ */
+Matrix<size_t> burned_amounts_per_cell_multiprocess(
     const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
     SimulationParams params, float distance, float elevation_mean, float elevation_sd,
-    float upper_limit, size_t n_replicates, std::string output_filename_suffix
+    float upper_limit, size_t n_replicates, size_t n_workers, std::string output_filename_suffix
 );
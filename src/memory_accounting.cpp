@@ -0,0 +1,97 @@
+#include "memory_accounting.hpp"
+
+#include <atomic>
+
+#include <sys/resource.h>
+
+namespace {
+
+std::atomic<size_t> current[N_MEMORY_COMPONENTS];
+std::atomic<size_t> peak[N_MEMORY_COMPONENTS];
+std::atomic<size_t> current_host;
+std::atomic<size_t> peak_host;
+
+void raise_peak(std::atomic<size_t>& peak, size_t value) {
+  size_t previous = peak.load(std::memory_order_relaxed);
+  while (previous < value &&
+         !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+  }
+}
+
+// Adds `delta` (modulo 2^64, so a decrease is a wrapped negative) to a component
+void add_bytes(MemoryComponent component, size_t delta) {
+  size_t index = size_t(component);
+  raise_peak(peak[index], current[index].fetch_add(delta, std::memory_order_relaxed) + delta);
+  if (component != MemoryComponent::DEVICE_BUFFERS) {
+    raise_peak(peak_host, current_host.fetch_add(delta, std::memory_order_relaxed) + delta);
+  }
+}
+
+double megabytes(size_t bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+const char* memory_component_name(MemoryComponent component) {
+  switch (component) {
+  case MemoryComponent::LANDSCAPE:
+    return "landscape";
+  case MemoryComponent::DERIVED_LAYERS:
+    return "derived layers";
+  case MemoryComponent::EDGE_PROBABILITIES:
+    return "edge probabilities";
+  case MemoryComponent::FIRE_BUFFERS:
+    return "fire buffers";
+  case MemoryComponent::ACCUMULATORS:
+    return "accumulators";
+  case MemoryComponent::DEVICE_BUFFERS:
+    return "device buffers";
+  }
+  return "unknown";
+}
+
+MemoryUsage::MemoryUsage(MemoryComponent component, size_t bytes)
+    : component(component), bytes(0) {
+  set(bytes);
+}
+
+MemoryUsage::~MemoryUsage() {
+  set(0);
+}
+
+void MemoryUsage::set(size_t new_bytes) {
+  if (new_bytes != bytes) {
+    add_bytes(component, new_bytes - bytes);
+    bytes = new_bytes;
+  }
+}
+
+size_t memory_peak_bytes(MemoryComponent component) {
+  return peak[size_t(component)].load(std::memory_order_relaxed);
+}
+
+size_t memory_peak_host_bytes() {
+  return peak_host.load(std::memory_order_relaxed);
+}
+
+size_t peak_resident_bytes() {
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return size_t(usage.ru_maxrss) * 1024; // kilobytes on Linux
+}
+
+void report_memory_usage(std::ostream& out) {
+  out << "  MEMORY USAGE (peak)" << std::endl;
+  for (size_t c = 0; c < N_MEMORY_COMPONENTS; c++) {
+    MemoryComponent component = MemoryComponent(c);
+    if (memory_peak_bytes(component) > 0) {
+      out << "* " << memory_component_name(component) << ": "
+          << megabytes(memory_peak_bytes(component)) << " MB" << std::endl;
+    }
+  }
+  out << "* Host total: " << megabytes(memory_peak_host_bytes()) << " MB" << std::endl;
+  out << "* Process resident: " << megabytes(peak_resident_bytes()) << " MB" << std::endl;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/* Runtime accounting of the large buffers of a run, by component.
+ *
+ * The code owning a large buffer keeps a MemoryUsage for it and updates it when the buffer grows.
+ * The current and peak bytes of every component are atomic counters, cheap enough to update once
+ * per replicate from any thread. DEVICE_BUFFERS is GPU memory, every other component is host
+ * memory.
+ */
+
+enum class MemoryComponent : uint8_t {
+  LANDSCAPE,
+  DERIVED_LAYERS,
+  EDGE_PROBABILITIES,
+  FIRE_BUFFERS,
+  ACCUMULATORS,
+  DEVICE_BUFFERS,
+};
+
+constexpr size_t N_MEMORY_COMPONENTS = 6;
+
+const char* memory_component_name(MemoryComponent component);
+
+class MemoryUsage {
+public:
+  explicit MemoryUsage(MemoryComponent component, size_t bytes = 0);
+  ~MemoryUsage();
+
+  MemoryUsage(const MemoryUsage&) = delete;
+  MemoryUsage& operator=(const MemoryUsage&) = delete;
+
+  // The buffer now takes `bytes`
+  void set(size_t bytes);
+
+private:
+  MemoryComponent component;
+  size_t bytes;
+};
+
+// Peak bytes of a component since the start of the process
+size_t memory_peak_bytes(MemoryComponent component);
+
+// Peak of the sum of the host components (not the sum of their peaks)
+size_t memory_peak_host_bytes();
+
+// Peak resident set size of the process, which also counts everything not accounted for
+size_t peak_resident_bytes();
+
+// Peak of every component that was used, the host total and the peak resident size
+void report_memory_usage(std::ostream& out);
@@ -0,0 +1,165 @@
+#include "memory_plan.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "derived_layers.hpp"
+#include "landscape.hpp"
+
+namespace {
+
+double megabytes(size_t bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+size_t megabytes_from_env(const char* name) {
+  const char* value = std::getenv(name);
+  if (!value) {
+    return 0;
+  }
+  double mb = std::atof(value);
+  if (!(mb > 0)) {
+    throw std::runtime_error(std::string("Invalid ") + name + " " + value + " (expected megabytes)");
+  }
+  return size_t(mb * 1024 * 1024);
+}
+
+bool fits(const MemoryPlan& plan, const MemoryBudget& budget) {
+  return (budget.host_bytes == 0 || plan.host_bytes() <= budget.host_bytes) &&
+         (budget.device_bytes == 0 || plan.device_bytes() <= budget.device_bytes);
+}
+
+} // namespace
+
+size_t MemoryPlan::bytes(MemoryComponent component) const {
+  size_t total = 0;
+  for (const MemoryPlanItem& item : items) {
+    if (item.component == component) {
+      total += item.bytes;
+    }
+  }
+  return total;
+}
+
+size_t MemoryPlan::host_bytes() const {
+  size_t total = 0;
+  for (const MemoryPlanItem& item : items) {
+    if (item.component != MemoryComponent::DEVICE_BUFFERS) {
+      total += item.bytes;
+    }
+  }
+  return total;
+}
+
+size_t MemoryPlan::device_bytes() const {
+  return bytes(MemoryComponent::DEVICE_BUFFERS);
+}
+
+MemoryPlan plan_memory(const MemoryPlanRequest& request) {
+  size_t n = request.width * request.height;
+  size_t n_threads = std::max<size_t>(request.n_threads, 1);
+  size_t landscape = LandscapeSoA::bytes_for(request.width, request.height);
+  size_t derived = DerivedLayers::bytes_for(request.width, request.height);
+  // Vectors that grow with the fires may reserve up to twice the cells they hold
+  size_t growing = 2;
+  // Burned cells and their steps of a CpuFireState that burned everything
+  size_t cpu_fire = n * sizeof(uint8_t) + growing * (2 * n + 1) * sizeof(size_t);
+
+  MemoryPlan plan = { request, {} };
+  auto add = [&](MemoryComponent component, std::string what, size_t bytes) {
+    plan.items.push_back({ component, what, bytes });
+  };
+  std::string per_thread = " (x" + std::to_string(n_threads) + " threads)";
+
+  add(MemoryComponent::LANDSCAPE, "landscape layers", landscape);
+
+  switch (request.engine) {
+  case EnsembleEngine::GPU: {
+    size_t steps = request.spread_options.record_steps ? n + 1 : 1;
+    add(MemoryComponent::FIRE_BUFFERS, "fire",
+        growing * (n * sizeof(uint32_t) + steps * sizeof(size_t)) +
+            (n + 63) / 64 * sizeof(uint64_t));
+    if (request.archive_queue_capacity > 0) {
+      // The queued fires and the one being built
+      add(MemoryComponent::FIRE_BUFFERS,
+          "archived fires (" + std::to_string(request.archive_queue_capacity + 1) + ")",
+          (request.archive_queue_capacity + 1) * (n * sizeof(uint32_t) + (n + 1) * sizeof(size_t)));
+    }
+    add(MemoryComponent::ACCUMULATORS, "burned amounts", 2 * n * sizeof(size_t));
+    if (request.checkpoint) {
+      add(MemoryComponent::ACCUMULATORS, "checkpoint snapshot", n * sizeof(size_t));
+    }
+    add(MemoryComponent::DEVICE_BUFFERS, "simulation buffers",
+        device_memory_bytes(request.width, request.height, request.spread_options));
+    break;
+  }
+  case EnsembleEngine::CPU_ESTIMATOR: {
+    size_t copies = std::max<size_t>(request.n_landscape_copies, 1);
+    add(MemoryComponent::LANDSCAPE,
+        "placed copies (" + std::to_string(copies) + ")", copies * landscape);
+    add(MemoryComponent::DERIVED_LAYERS,
+        "derived layers (" + std::to_string(copies) + ")", copies * derived);
+    add(MemoryComponent::FIRE_BUFFERS, "fire state, counts" + per_thread,
+        n_threads * (cpu_fire + n * sizeof(uint32_t) + growing * n * sizeof(size_t)));
+    add(MemoryComponent::ACCUMULATORS, "block sums" + per_thread,
+        n_threads * 2 * n * sizeof(double));
+    add(MemoryComponent::ACCUMULATORS, "probabilities, errors", 4 * n * sizeof(double));
+    break;
+  }
+  case EnsembleEngine::IGNITION_ENSEMBLE: {
+    add(MemoryComponent::DERIVED_LAYERS, "derived layers", derived);
+    add(MemoryComponent::EDGE_PROBABILITIES, "edge thresholds", 8 * n * sizeof(uint32_t));
+    add(MemoryComponent::EDGE_PROBABILITIES, "ignition sampler",
+        n * (sizeof(double) + sizeof(size_t)));
+    add(MemoryComponent::FIRE_BUFFERS, "fire state" + per_thread, n_threads * cpu_fire);
+    add(MemoryComponent::ACCUMULATORS, "counts" + per_thread, n_threads * n * sizeof(uint32_t));
+    add(MemoryComponent::ACCUMULATORS, "probabilities, replicates",
+        n * sizeof(double) +
+            request.n_replicates * (sizeof(std::pair<size_t, size_t>) + sizeof(size_t)));
+    break;
+  }
+  }
+  return plan;
+}
+
+MemoryBudget memory_budget_from_env() {
+  MemoryBudget budget;
+  budget.host_bytes = megabytes_from_env("FIRE_SPREAD_MEMORY_BUDGET");
+  budget.device_bytes = megabytes_from_env("FIRE_SPREAD_DEVICE_MEMORY_BUDGET");
+  return budget;
+}
+
+MemoryPlan fit_memory_budget(MemoryPlanRequest request, const MemoryBudget& budget) {
+  MemoryPlan plan = plan_memory(request);
+  while (!fits(plan, budget)) {
+    if (request.engine != EnsembleEngine::GPU && request.n_threads > 1) {
+      request.n_threads--;
+    } else if (request.archive_queue_capacity > 1) {
+      request.archive_queue_capacity /= 2;
+    } else {
+      std::ostringstream message;
+      message << "The ensemble needs more memory than the budget (" << megabytes(budget.host_bytes)
+              << " MB host, " << megabytes(budget.device_bytes) << " MB device, 0 is no limit):"
+              << std::endl;
+      print_memory_plan(plan, message);
+      throw std::runtime_error(message.str());
+    }
+    plan = plan_memory(request);
+  }
+  return plan;
+}
+
+void print_memory_plan(const MemoryPlan& plan, std::ostream& out) {
+  out << "  MEMORY PLAN (upper bound)" << std::endl;
+  for (const MemoryPlanItem& item : plan.items) {
+    out << "* " << memory_component_name(item.component) << ", " << item.what << ": "
+        << megabytes(item.bytes) << " MB" << std::endl;
+  }
+  out << "* Host total: " << megabytes(plan.host_bytes()) << " MB" << std::endl;
+  if (plan.device_bytes() > 0) {
+    out << "* Device total: " << megabytes(plan.device_bytes()) << " MB" << std::endl;
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "memory_accounting.hpp"
+#include "spread_functions.cuh"
+
+/* Peak memory of an ensemble, estimated before it starts.
+ *
+ * The estimates are upper bounds: the reachable window is taken to be the whole landscape and every
+ * fire to burn all of its cells, so a real run uses at most what is planned (plus the allocator and
+ * page rounding). Compare them with the peaks that `report_memory_usage` prints at the end.
+ */
+
+enum class EnsembleEngine {
+  // burned_amounts_per_cell, one replicate after another on the GPU
+  GPU,
+  // estimate_burn_probabilities, on the host threads
+  CPU_ESTIMATOR,
+  // simulate_ignition_ensemble, on the host threads
+  IGNITION_ENSEMBLE,
+};
+
+struct MemoryPlanRequest {
+  size_t width = 0;
+  size_t height = 0;
+  EnsembleEngine engine = EnsembleEngine::GPU;
+  // Host threads of the CPU engines
+  size_t n_threads = 1;
+  size_t n_replicates = 0;
+  // Options of the GPU engine: fires queued for a FireArchiveWriter (0 without an archive), whether
+  // the counts are checkpointed and the options of every simulation
+  size_t archive_queue_capacity = 0;
+  bool checkpoint = false;
+  SpreadOptions spread_options;
+  // Copies of the landscape placed for the CPU estimator, see NumaLandscape
+  size_t n_landscape_copies = 1;
+};
+
+struct MemoryPlanItem {
+  MemoryComponent component;
+  std::string what;
+  size_t bytes;
+};
+
+struct MemoryPlan {
+  MemoryPlanRequest request;
+  std::vector<MemoryPlanItem> items;
+
+  size_t bytes(MemoryComponent component) const;
+  size_t host_bytes() const;
+  size_t device_bytes() const;
+};
+
+MemoryPlan plan_memory(const MemoryPlanRequest& request);
+
+// In bytes, 0 for no limit
+struct MemoryBudget {
+  size_t host_bytes = 0;
+  size_t device_bytes = 0;
+};
+
+// FIRE_SPREAD_MEMORY_BUDGET and FIRE_SPREAD_DEVICE_MEMORY_BUDGET, in megabytes
+MemoryBudget memory_budget_from_env();
+
+/* Plan of `request` adapted to fit `budget`: the CPU engines run with fewer threads and the GPU
+ * engine queues fewer fires for the archive. Throws if even the smallest configuration doesn't fit.
+ */
+MemoryPlan fit_memory_budget(MemoryPlanRequest request, const MemoryBudget& budget);
+
+void print_memory_plan(const MemoryPlan& plan, std::ostream& out);
@@ -0,0 +1,239 @@
+#include "multi_param_spread.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+#include "csv.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+namespace {
+
+typedef uint16_t LaneMask;
+static_assert(sizeof(LaneMask) * 8 >= PARAM_LANES, "LaneMask must have a bit per lane");
+
+// Parameters of up to PARAM_LANES sets, one array per coefficient so the lane loop is contiguous
+struct LaneParams {
+  float independent[PARAM_LANES];
+  float vegetation[4][PARAM_LANES]; // indexed by VegetationType, MATORRAL is always 0
+  float fwi[PARAM_LANES];
+  float aspect[PARAM_LANES];
+  float wind[PARAM_LANES];
+  float elevation[PARAM_LANES];
+  float slope[PARAM_LANES];
+};
+
+LaneParams lane_params(const SimulationParams* params, size_t n_lanes) {
+  LaneParams lanes = {};
+  for (size_t l = 0; l < n_lanes; l++) {
+    lanes.independent[l] = params[l].independent_pred;
+    lanes.vegetation[SUBALPINE][l] = params[l].subalpine_pred;
+    lanes.vegetation[WET][l] = params[l].wet_pred;
+    lanes.vegetation[DRY][l] = params[l].dry_pred;
+    lanes.fwi[l] = params[l].fwi_pred;
+    lanes.aspect[l] = params[l].aspect_pred;
+    lanes.wind[l] = params[l].wind_pred;
+    lanes.elevation[l] = params[l].elevation_pred;
+    lanes.slope[l] = params[l].slope_pred;
+  }
+  return lanes;
+}
+
+struct FrontierCell {
+  size_t cell;
+  LaneMask lanes; // lanes in which the cell burned in the previous step
+};
+
+void simulate_lanes(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    const SimulationParams* params, size_t n_lanes, float distance, float elevation_mean,
+    float elevation_sd, uint64_t seed, float upper_limit, Fire* fires
+) {
+  const LaneParams lanes = lane_params(params, n_lanes);
+  const LaneMask all_lanes = LaneMask((1u << n_lanes) - 1);
+
+  int width = landscape.width;
+  int height = landscape.height;
+
+  std::vector<LaneMask> burned(landscape.width * landscape.height, 0);
+  std::vector<LaneMask> burned_now(landscape.width * landscape.height, 0);
+  std::vector<FrontierCell> frontier, next_frontier;
+  unsigned int processed_cells[PARAM_LANES] = {};
+
+  for (size_t l = 0; l < n_lanes; l++) {
+    fires[l].reset(landscape.width, landscape.height);
+  }
+  for (auto [x, y] : ignition_cells) {
+    size_t idx = utils::INDEX(x, y, landscape.width);
+    if (!burned[idx]) {
+      burned[idx] = all_lanes;
+      frontier.push_back({ idx, all_lanes });
+      for (size_t l = 0; l < n_lanes; l++) {
+        fires[l].add_burned(idx);
+      }
+    }
+  }
+  for (size_t l = 0; l < n_lanes; l++) {
+    fires[l].burned_ids_steps.push_back(fires[l].n_burned());
+  }
+
+  float linpred[PARAM_LANES];
+
+  while (!frontier.empty()) {
+    TRACE_SPAN("spread_step", "simulation", "step", fires[0].burned_ids_steps.size() - 1);
+    next_frontier.clear();
+
+    for (const FrontierCell& burning : frontier) {
+      int i = burning.cell % width;
+      int j = burning.cell / width;
+      float burning_elevation = landscape.elevation[burning.cell];
+      float burning_wind_direction = landscape.wind_dir[burning.cell];
+
+      unsigned int in_bounds = 0;
+      for (int n = 0; n < N_NEIGHBORS; n++) {
+        int ni = i + MOVES[n][0];
+        int nj = j + MOVES[n][1];
+        if (ni < 0 || nj < 0 || ni >= width || nj >= height) {
+          continue;
+        }
+        in_bounds++;
+
+        size_t neighbor = utils::INDEX(ni, nj, width);
+        LaneMask candidates = burning.lanes & ~burned[neighbor];
+        if (!candidates || !landscape.burnable[neighbor]) {
+          continue;
+        }
+
+        // Terms shared by every lane, same expressions as spread_probability_cpu
+        float elevation = landscape.elevation[neighbor];
+        float slope_term = std::sin(std::atan((elevation - burning_elevation) / distance));
+        float wind_term = std::cos(ANGLES[n] - burning_wind_direction);
+        float elev_term = (elevation - elevation_mean) / elevation_sd;
+        int vegetation = landscape.vegetation_type[neighbor];
+        vegetation = vegetation >= SUBALPINE && vegetation <= DRY ? vegetation : MATORRAL;
+        float fwi = landscape.fwi[neighbor];
+        float aspect = landscape.aspect[neighbor];
+
+        #pragma omp simd
+        for (size_t l = 0; l < PARAM_LANES; l++) {
+          float lp = lanes.independent[l];
+          if (vegetation != MATORRAL) {
+            lp += lanes.vegetation[vegetation][l];
+          }
+          lp += lanes.fwi[l] * fwi;
+          lp += lanes.aspect[l] * aspect;
+          lp += wind_term * lanes.wind[l] + elev_term * lanes.elevation[l] +
+                slope_term * lanes.slope[l];
+          linpred[l] = lp;
+        }
+
+        // The logistic is only evaluated for the lanes that can still burn the neighbor
+        float draw = edge_uniform(seed, burning.cell, n);
+        LaneMask ignited = 0;
+        for (LaneMask pending = candidates; pending; pending &= pending - 1) {
+          int l = __builtin_ctz(pending);
+          if (draw < upper_limit / (1.0f + std::exp(-linpred[l]))) {
+            ignited |= LaneMask(1u << l);
+          }
+        }
+        if (!ignited) {
+          continue;
+        }
+
+        burned[neighbor] |= ignited;
+        if (!burned_now[neighbor]) {
+          next_frontier.push_back({ neighbor, 0 });
+        }
+        burned_now[neighbor] |= ignited;
+      }
+
+      for (size_t l = 0; l < n_lanes; l++) {
+        processed_cells[l] += ((burning.lanes >> l) & 1) * in_bounds;
+      }
+    }
+
+    for (FrontierCell& cell : next_frontier) {
+      cell.lanes = burned_now[cell.cell];
+      burned_now[cell.cell] = 0;
+      for (size_t l = 0; l < n_lanes; l++) {
+        if ((cell.lanes >> l) & 1) {
+          fires[l].add_burned(cell.cell);
+        }
+      }
+    }
+    for (size_t l = 0; l < n_lanes; l++) {
+      if (fires[l].n_burned() != fires[l].burned_ids_steps.back()) {
+        fires[l].burned_ids_steps.push_back(fires[l].n_burned());
+      }
+    }
+    std::swap(frontier, next_frontier);
+  }
+
+  for (size_t l = 0; l < n_lanes; l++) {
+    fires[l].processed_cells = processed_cells[l];
+  }
+}
+
+} // namespace
+
+std::vector<Fire> simulate_fire_multi_param(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    const std::vector<SimulationParams>& params, float distance, float elevation_mean,
+    float elevation_sd, int n_replicate, float upper_limit
+) {
+  require_contiguous(landscape, "The multi-parameter engine");
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<Fire> fires(params.size(), empty_fire(0, 0));
+  for (size_t first = 0; first < params.size(); first += PARAM_LANES) {
+    size_t n_lanes = std::min(PARAM_LANES, params.size() - first);
+    simulate_lanes(
+        landscape, ignition_cells, &params[first], n_lanes, distance, elevation_mean, elevation_sd,
+        replicate_seed(n_replicate), upper_limit, &fires[first]
+    );
+  }
+
+  // The traversal is shared, so the time is split evenly among the parameter sets
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (Fire& fire : fires) {
+    fire.time_taken = seconds / params.size();
+  }
+  return fires;
+}
+
+std::vector<SimulationParams> read_params_file(std::string filename) {
+
+  std::ifstream file(filename);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("Can't open parameters file");
+  }
+
+  std::vector<SimulationParams> params;
+
+  CSVIterator loop(file);
+  loop++; // skip first line
+
+  for (; loop != CSVIterator(); ++loop) {
+    if (loop->size() == 1 && (*loop)[0].empty()) {
+      continue; // blank line
+    }
+    if (loop->size() < 9) {
+      throw std::runtime_error("Invalid parameters file");
+    }
+    const CSVRow& row = *loop;
+    params.push_back({
+      float(atof(row[0].data())), float(atof(row[1].data())), float(atof(row[2].data())),
+      float(atof(row[3].data())), float(atof(row[4].data())), float(atof(row[5].data())),
+      float(atof(row[6].data())), float(atof(row[7].data())), float(atof(row[8].data())),
+    });
+  }
+
+  file.close();
+
+  return params;
+}
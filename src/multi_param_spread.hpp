@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "fires.hpp"
+#include "landscape.hpp"
+#include "spread_functions.cuh"
+
+/* Host engine that simulates the same replicate with several parameter sets in one traversal.
+ *
+ * Every parameter set (lane) keeps its own burn state, but the frontiers of all lanes are walked
+ * together: the layers of a neighbor, its slope, wind and elevation terms are computed once and
+ * only the linear predictor and the logistic are evaluated per lane, in a loop over the lanes that
+ * the compiler vectorizes. All lanes use the draws of `replicate_seed(n_replicate)`, so lane `l` is
+ * exactly the fire of `simulate_fire_cpu` with `params[l]` (common random numbers across the sweep).
+ */
+
+// Parameter sets evaluated together, larger batches are split
+constexpr size_t PARAM_LANES = 16;
+
+std::vector<Fire> simulate_fire_multi_param(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    const std::vector<SimulationParams>& params, float distance, float elevation_mean,
+    float elevation_sd, int n_replicate, float upper_limit
+);
+
+// Reads a csv file with a header line and one parameter set per line, with the nine columns of
+// `SimulationParams` in declaration order
+std::vector<SimulationParams> read_params_file(std::string filename);
@@ -0,0 +1,301 @@
+#include "numa.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+namespace {
+
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// Parses a kernel list such as "0-3,8-11"
+std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int first = std::atoi(range.c_str());
+    int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::string read_line(const std::string& filename) {
+  std::ifstream file(filename);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+bool pin_to_cpus(const std::vector<int>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool env_flag(const char* name) {
+  const char* value = std::getenv(name);
+  return value && *value && std::strcmp(value, "0") != 0;
+}
+
+size_t mapped_size(size_t size, bool huge_pages) {
+  size = std::max<size_t>(size, 1);
+  return huge_pages ? (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1) : size;
+}
+
+size_t align_up(size_t offset) {
+  return (offset + 63) & ~size_t(63);
+}
+
+} // namespace
+
+int NumaTopology::node_of_cpu(int cpu) const {
+  for (size_t node = 0; node < node_cpus.size(); node++) {
+    for (int node_cpu : node_cpus[node]) {
+      if (node_cpu == cpu) {
+        return node;
+      }
+    }
+  }
+  return 0;
+}
+
+NumaTopology detect_numa_topology() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    throw std::runtime_error("Can't read the CPU affinity of the process");
+  }
+
+  NumaTopology topology;
+  std::vector<int> online = parse_cpu_list(read_line("/sys/devices/system/node/online"));
+  for (int node : online) {
+    std::vector<int> cpus;
+    std::string cpu_list =
+        read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    for (int cpu : parse_cpu_list(cpu_list)) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      topology.node_ids.push_back(node);
+      topology.node_cpus.push_back(cpus);
+    }
+  }
+
+  if (topology.node_cpus.empty()) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    topology.node_ids = { 0 };
+    topology.node_cpus = { cpus };
+  }
+  return topology;
+}
+
+NumaConfig numa_config_from_env() {
+  NumaConfig config = { NumaPlacement::FIRST_TOUCH, env_flag("FIRE_SPREAD_HUGE_PAGES"),
+                        env_flag("FIRE_SPREAD_PIN_THREADS") };
+  const char* placement = std::getenv("FIRE_SPREAD_NUMA");
+  if (placement && std::strcmp(placement, "replicate") == 0) {
+    config.placement = NumaPlacement::REPLICATE;
+  } else if (placement && std::strcmp(placement, "interleave") == 0) {
+    config.placement = NumaPlacement::INTERLEAVE;
+  } else if (placement && *placement) {
+    throw std::runtime_error(
+        std::string("Unknown FIRE_SPREAD_NUMA ") + placement + " (expected replicate or interleave)"
+    );
+  }
+  return config;
+}
+
+ThreadPin::ThreadPin(const NumaTopology& topology, int thread) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        previous_cpus.push_back(cpu);
+      }
+    }
+  }
+  size_t n_nodes = topology.n_nodes();
+  pinned_node = thread % n_nodes;
+  const std::vector<int>& cpus = topology.node_cpus[pinned_node];
+  pin_to_cpus({ cpus[(thread / n_nodes) % cpus.size()] });
+}
+
+ThreadPin::~ThreadPin() {
+  if (!previous_cpus.empty()) {
+    pin_to_cpus(previous_cpus);
+  }
+}
+
+int current_numa_node(const NumaTopology& topology) {
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : topology.node_of_cpu(cpu);
+}
+
+void run_on_each_node(const NumaTopology& topology, const std::function<void(int)>& function) {
+  std::vector<std::exception_ptr> errors(topology.n_nodes());
+  std::vector<std::thread> threads;
+  for (size_t node = 0; node < topology.n_nodes(); node++) {
+    threads.emplace_back([&, node]() {
+      pin_to_cpus(topology.node_cpus[node]);
+      try {
+        function(node);
+      } catch (...) {
+        errors[node] = std::current_exception();
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (std::exception_ptr& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+void* allocate_pages(size_t size, bool huge_pages, const std::vector<int>& interleave_node_ids) {
+  size = mapped_size(size, huge_pages);
+  // Over-allocated by a huge page and trimmed, mmap only guarantees the alignment of small pages
+  size_t reserved = huge_pages ? size + HUGE_PAGE_SIZE : size;
+  void* mapping =
+      mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+
+  char* data = static_cast<char*>(mapping);
+  if (huge_pages) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(mapping);
+    size_t head = ((address + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)) - address;
+    if (head > 0) {
+      munmap(data, head);
+    }
+    munmap(data + head + size, HUGE_PAGE_SIZE - head);
+    data += head;
+    madvise(data, size, MADV_HUGEPAGE); // only a hint, ignored without transparent huge pages
+  }
+
+  if (interleave_node_ids.size() > 1) {
+    unsigned long mask = 0;
+    for (int node : interleave_node_ids) {
+      if (node < int(8 * sizeof(mask))) {
+        mask |= 1UL << node;
+      }
+    }
+    // Best effort as well, without it pages are placed by first touch
+    syscall(SYS_mbind, data, size, MPOL_INTERLEAVE, &mask, 8 * sizeof(mask), 0);
+  }
+  return data;
+}
+
+void free_pages(void* data, size_t size, bool huge_pages) {
+  if (data) {
+    munmap(data, mapped_size(size, huge_pages));
+  }
+}
+
+NumaLandscape::NumaLandscape(
+    const LandscapeView& landscape, const NumaTopology& topology, const NumaConfig& config
+)
+    : width(landscape.width), height(landscape.height), huge_pages(config.huge_pages) {
+  TRACE_SPAN("place_landscape", "setup");
+  size_t n_cells = width * height;
+
+  // Every layer starts on a cache line
+  size_t offsets[6];
+  size_t offset = 0;
+  for (int layer = 0; layer < 6; layer++) {
+    offsets[layer] = offset;
+    offset = align_up(offset + n_cells * (layer < 5 ? sizeof(float) : sizeof(uint8_t)));
+  }
+  size = offset;
+
+  auto place = [&](Replica& replica, const std::vector<int>& interleave_node_ids) {
+    char* data = static_cast<char*>(allocate_pages(size, huge_pages, interleave_node_ids));
+    const float* layers[5] = { landscape.elevation, landscape.fwi, landscape.aspect,
+                               landscape.vegetation_type, landscape.wind_dir };
+    // Row by row, so that the copy of a window is contiguous
+    for (size_t j = 0; j < height; j++) {
+      size_t src = j * landscape.row_stride();
+      for (int layer = 0; layer < 5; layer++) {
+        std::memcpy(
+            data + offsets[layer] + j * width * sizeof(float), layers[layer] + src,
+            width * sizeof(float)
+        );
+      }
+      std::memcpy(data + offsets[5] + j * width, landscape.burnable + src, width);
+    }
+
+    replica.data = data;
+    replica.view = {
+      width,
+      height,
+      reinterpret_cast<const float*>(data + offsets[0]),
+      reinterpret_cast<const float*>(data + offsets[1]),
+      reinterpret_cast<const float*>(data + offsets[2]),
+      reinterpret_cast<const float*>(data + offsets[3]),
+      reinterpret_cast<const float*>(data + offsets[4]),
+      reinterpret_cast<const uint8_t*>(data + offsets[5]),
+    };
+  };
+
+  if (config.placement == NumaPlacement::REPLICATE && topology.n_nodes() > 1) {
+    // Each copy is written (first touched) by a thread of its node
+    replicas.assign(topology.n_nodes(), { nullptr, {} });
+    try {
+      run_on_each_node(topology, [&](int node) { place(replicas[node], {}); });
+    } catch (...) {
+      for (Replica& replica : replicas) {
+        free_pages(replica.data, size, huge_pages);
+      }
+      throw;
+    }
+  } else {
+    replicas.assign(1, { nullptr, {} });
+    bool interleave = config.placement == NumaPlacement::INTERLEAVE;
+    place(replicas[0], interleave ? topology.node_ids : std::vector<int>());
+  }
+}
+
+NumaLandscape::~NumaLandscape() {
+  for (Replica& replica : replicas) {
+    free_pages(replica.data, size, huge_pages);
+  }
+}
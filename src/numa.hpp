@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "landscape.hpp"
+
+/* NUMA-aware placement of the data read by the host engine.
+ *
+ * Pages live on the node of the thread that first writes them, so a landscape loaded by one thread
+ * is read remotely by every thread of the other sockets. Placement is chosen with environment
+ * variables (all off by default):
+ * - FIRE_SPREAD_NUMA=replicate: one copy of the read-only layers per node, written by a thread of
+ *   that node; FIRE_SPREAD_NUMA=interleave: a single copy with its pages spread over the nodes
+ * - FIRE_SPREAD_HUGE_PAGES=1: big buffers are aligned to 2 MB and backed by transparent huge pages
+ * - FIRE_SPREAD_PIN_THREADS=1: each OpenMP thread is pinned to a CPU, spread over the nodes like
+ *   OMP_PROC_BIND=spread, so that its per-thread state stays node-local
+ */
+
+struct NumaTopology {
+  // Kernel ids of the nodes with CPUs that the process may run on, and the CPUs of each one
+  std::vector<int> node_ids;
+  std::vector<std::vector<int>> node_cpus;
+
+  size_t n_nodes() const {
+    return node_cpus.size();
+  }
+
+  // Node (index in node_ids) of `cpu`, 0 if unknown
+  int node_of_cpu(int cpu) const;
+};
+
+// Read from /sys/devices/system/node, a single node with every allowed CPU if unavailable
+NumaTopology detect_numa_topology();
+
+enum class NumaPlacement { FIRST_TOUCH, REPLICATE, INTERLEAVE };
+
+struct NumaConfig {
+  NumaPlacement placement;
+  bool huge_pages;
+  bool pin_threads;
+};
+
+NumaConfig numa_config_from_env();
+
+/* Pins the calling thread to the CPU of OpenMP thread `thread` (round-robin over the nodes, then
+ * over the CPUs of each node) while it is alive. The affinity the thread had is restored on
+ * destruction: OpenMP reuses its threads, including the caller's, for unrelated parallel regions.
+ */
+class ThreadPin {
+public:
+  ThreadPin(const NumaTopology& topology, int thread);
+  ThreadPin(const ThreadPin&) = delete;
+  ThreadPin& operator=(const ThreadPin&) = delete;
+  ~ThreadPin();
+
+  int node() const {
+    return pinned_node;
+  }
+
+private:
+  int pinned_node;
+  std::vector<int> previous_cpus; // empty if the affinity couldn't be read
+};
+
+// Node of the CPU the calling thread runs on
+int current_numa_node(const NumaTopology& topology);
+
+// Runs `function(node)` on a thread pinned to each node, all nodes at once
+void run_on_each_node(const NumaTopology& topology, const std::function<void(int)>& function);
+
+// Anonymous pages, rounded up to and aligned to 2 MB with transparent huge pages requested if
+// `huge_pages`. Interleaved over `interleave_node_ids` if it has more than one node.
+void* allocate_pages(size_t size, bool huge_pages, const std::vector<int>& interleave_node_ids = {});
+void free_pages(void* data, size_t size, bool huge_pages);
+
+// Allocator for big per-thread buffers, e.g. std::vector<double, HugePageAllocator<double>>
+template <typename T> struct HugePageAllocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  bool huge_pages = true;
+
+  HugePageAllocator() = default;
+  explicit HugePageAllocator(bool huge_pages) : huge_pages(huge_pages) {}
+  template <typename U>
+  HugePageAllocator(const HugePageAllocator<U>& other) : huge_pages(other.huge_pages) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(allocate_pages(n * sizeof(T), huge_pages));
+  }
+
+  void deallocate(T* data, size_t n) {
+    free_pages(data, n * sizeof(T), huge_pages);
+  }
+
+  template <typename U> bool operator==(const HugePageAllocator<U>& other) const {
+    return huge_pages == other.huge_pages;
+  }
+
+  template <typename U> bool operator!=(const HugePageAllocator<U>& other) const {
+    return huge_pages != other.huge_pages;
+  }
+};
+
+template <typename T> using HugePageVector = std::vector<T, HugePageAllocator<T>>;
+
+// Read-only copy of a landscape placed according to a NumaConfig
+class NumaLandscape {
+public:
+  NumaLandscape(
+      const LandscapeView& landscape, const NumaTopology& topology, const NumaConfig& config
+  );
+
+  NumaLandscape(const NumaLandscape&) = delete;
+  NumaLandscape& operator=(const NumaLandscape&) = delete;
+  ~NumaLandscape();
+
+  // Number of copies, one per node with REPLICATE
+  size_t n_replicas() const {
+    return replicas.size();
+  }
+
+  // Copy read by the threads of `node`
+  size_t replica_of(int node) const {
+    return replicas.size() > 1 ? node : 0;
+  }
+
+  LandscapeView view(int node) const {
+    return replicas[replica_of(node)].view;
+  }
+
+  // Bytes taken by all the copies
+  size_t bytes() const {
+    return replicas.size() * size;
+  }
+
+private:
+  struct Replica {
+    void* data;
+    LandscapeView view;
+  };
+
+  size_t width, height;
+  size_t size;
+  bool huge_pages;
+  std::vector<Replica> replicas;
+};
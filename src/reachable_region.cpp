@@ -0,0 +1,113 @@
+#include "reachable_region.hpp"
+
+#include <algorithm>
+#include <omp.h>
+
+#include "trace.hpp"
+
+CropWindow reachable_window(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells
+) {
+  TRACE_SPAN("reachable_window", "setup");
+
+  const int width = landscape.width;
+  const int height = landscape.height;
+  const size_t stride = landscape.row_stride();
+  if (ignition_cells.empty()) {
+    return { 0, 0, landscape.width, landscape.height };
+  }
+
+  std::vector<uint8_t> visited(landscape.width * landscape.height, 0);
+  std::vector<size_t> frontier;
+  for (auto [x, y] : ignition_cells) {
+    size_t idx = utils::INDEX(x, y, width);
+    if (!visited[idx]) {
+      visited[idx] = 1;
+      frontier.push_back(idx);
+    }
+  }
+
+  size_t min_x = width, min_y = height, max_x = 0, max_y = 0;
+
+  while (!frontier.empty()) {
+    std::vector<size_t> next;
+
+    #pragma omp parallel reduction(min : min_x, min_y) reduction(max : max_x, max_y)
+    {
+      std::vector<size_t> local_next;
+
+      #pragma omp for schedule(static) nowait
+      for (size_t f = 0; f < frontier.size(); f++) {
+        int i = frontier[f] % width;
+        int j = frontier[f] / width;
+        min_x = std::min(min_x, size_t(i));
+        max_x = std::max(max_x, size_t(i));
+        min_y = std::min(min_y, size_t(j));
+        max_y = std::max(max_y, size_t(j));
+
+        for (int di = -1; di <= 1; di++) {
+          for (int dj = -1; dj <= 1; dj++) {
+            int ni = i + di;
+            int nj = j + dj;
+            if (ni < 0 || nj < 0 || ni >= width || nj >= height) {
+              continue;
+            }
+            size_t n_idx = utils::INDEX(ni, nj, width);
+            if (landscape.burnable[nj * stride + ni] && !__atomic_load_n(&visited[n_idx], __ATOMIC_RELAXED) &&
+                !__atomic_exchange_n(&visited[n_idx], 1, __ATOMIC_RELAXED)) {
+              local_next.push_back(n_idx);
+            }
+          }
+        }
+      }
+
+      #pragma omp critical
+      next.insert(next.end(), local_next.begin(), local_next.end());
+    }
+
+    frontier.swap(next);
+  }
+
+  return { min_x, min_y, max_x - min_x + 1, max_y - min_y + 1 };
+}
+
+CropWindow reachable_window(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells
+) {
+  return reachable_window(landscape.view(), ignition_cells);
+}
+
+LandscapeView window_view(const LandscapeView& landscape, const CropWindow& window) {
+  return landscape.window(window.x0, window.y0, window.width, window.height);
+}
+
+LandscapeSoA crop_landscape(const LandscapeView& landscape, const CropWindow& window) {
+  TRACE_SPAN("crop_landscape", "setup");
+
+  LandscapeSoA cropped(window.width, window.height);
+  for (size_t j = 0; j < window.height; j++) {
+    size_t src = (window.y0 + j) * landscape.row_stride() + window.x0;
+    size_t dst = j * window.width;
+    std::copy_n(&landscape.elevation[src], window.width, &cropped.elevation[dst]);
+    std::copy_n(&landscape.fwi[src], window.width, &cropped.fwi[dst]);
+    std::copy_n(&landscape.aspect[src], window.width, &cropped.aspect[dst]);
+    std::copy_n(&landscape.vegetation_type[src], window.width, &cropped.vegetation_type[dst]);
+    std::copy_n(&landscape.wind_dir[src], window.width, &cropped.wind_dir[dst]);
+    std::copy_n(&landscape.burnable[src], window.width, &cropped.burnable[dst]);
+  }
+  return cropped;
+}
+
+LandscapeSoA crop_landscape(const LandscapeSoA& landscape, const CropWindow& window) {
+  return crop_landscape(landscape.view(), window);
+}
+
+std::vector<std::pair<size_t, size_t>> crop_ignition_cells(
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, const CropWindow& window
+) {
+  std::vector<std::pair<size_t, size_t>> cropped;
+  for (auto [x, y] : ignition_cells) {
+    cropped.push_back({ x - window.x0, y - window.y0 });
+  }
+  return cropped;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "fires.hpp"
+#include "landscape.hpp"
+#include "matrix.hpp"
+
+/* Cropping of a landscape to the only region a fire can reach.
+ *
+ * The fire can only spread into burnable cells 8-connected to the ignition cells, everything else
+ * never burns. Simulating on the bounding box of that component (instead of the whole grid) is
+ * equivalent, and on landscapes dominated by rock or water it is much smaller.
+ */
+
+// Rectangle [x0, x0 + width) x [y0, y0 + height) of a larger landscape
+struct CropWindow {
+  size_t x0, y0;
+  size_t width, height;
+};
+
+// Bounding box of the cells reachable from `ignition_cells`, found with a parallel
+// level-synchronous flood fill over `burnable`. The whole landscape if there are no ignitions.
+CropWindow reachable_window(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells
+);
+CropWindow reachable_window(
+    const LandscapeSoA& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells
+);
+
+// View of the window that shares the layers of `landscape`, see LandscapeView
+LandscapeView window_view(const LandscapeView& landscape, const CropWindow& window);
+
+// Contiguous copy of the window
+LandscapeSoA crop_landscape(const LandscapeView& landscape, const CropWindow& window);
+LandscapeSoA crop_landscape(const LandscapeSoA& landscape, const CropWindow& window);
+
+// Ignition cells in the coordinates of the window
+std::vector<std::pair<size_t, size_t>> crop_ignition_cells(
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, const CropWindow& window
+);
+
+// Adds `cropped` (indexed in window coordinates) to `full`
+template <typename T>
+void add_cropped_amounts(Matrix<T>& full, const Matrix<T>& cropped, const CropWindow& window) {
+  for (size_t j = 0; j < window.height; j++) {
+    for (size_t i = 0; i < window.width; i++) {
+      full[{ window.x0 + i, window.y0 + j }] += cropped[{ i, j }];
+    }
+  }
+}
@@ -0,0 +1,154 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "many_simulations.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const uint64_t CACHE_MAGIC = 0x3148434143524946ULL; // "FIRCACH1"
+
+struct CacheHeader {
+  uint64_t magic;
+  uint64_t width, height;
+  uint64_t first_replicate, n_replicates;
+};
+
+} // namespace
+
+ResultCache::ResultCache(std::string directory, size_t batch_size)
+    : directory(directory), batch(batch_size) {
+  if (batch == 0) {
+    throw std::runtime_error("Result cache batches must have at least one replicate");
+  }
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::runtime_error("Can't create result cache directory " + directory);
+  }
+}
+
+std::string ResultCache::key(
+    uint64_t landscape_hash, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    const SimulationParams& params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit
+) {
+  uint64_t hash = fnv1a(&SPREAD_ENGINE_VERSION, sizeof(SPREAD_ENGINE_VERSION));
+  hash = fnv1a(&landscape_hash, sizeof(landscape_hash), hash);
+  for (auto [x, y] : ignition_cells) {
+    uint64_t cell[2] = { x, y };
+    hash = fnv1a(cell, sizeof(cell), hash);
+  }
+  hash = fnv1a(&params, sizeof(params), hash);
+  float constants[4] = { distance, elevation_mean, elevation_sd, upper_limit };
+  hash = fnv1a(constants, sizeof(constants), hash);
+
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return hex;
+}
+
+std::string ResultCache::filename(
+    const std::string& key, size_t first_replicate, size_t n_replicates
+) const {
+  return directory + "/" + key + "-" + std::to_string(first_replicate) + "-" +
+         std::to_string(n_replicates) + ".counts";
+}
+
+std::optional<Matrix<size_t>> ResultCache::load(
+    const std::string& key, size_t first_replicate, size_t n_replicates, size_t width,
+    size_t height
+) const {
+  std::ifstream file(filename(key, first_replicate, n_replicates), std::ios::binary);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  CacheHeader header;
+  Matrix<size_t> burned_amounts(width, height);
+  std::vector<uint32_t> counts(width * height);
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  file.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(uint32_t));
+  if (!file || header.magic != CACHE_MAGIC || header.width != width || header.height != height ||
+      header.first_replicate != first_replicate || header.n_replicates != n_replicates) {
+    return std::nullopt; // treated as a miss, the batch is simulated and stored again
+  }
+  std::copy(counts.begin(), counts.end(), burned_amounts.elems.begin());
+  return burned_amounts;
+}
+
+void ResultCache::store(
+    const std::string& key, size_t first_replicate, size_t n_replicates,
+    const Matrix<size_t>& burned_amounts
+) const {
+  // Written to a temporary file and renamed, so concurrent jobs never read a partial batch
+  std::string final_name = filename(key, first_replicate, n_replicates);
+  std::string temporary_name = final_name + ".tmp" + std::to_string(getpid());
+
+  CacheHeader header = {
+    CACHE_MAGIC, burned_amounts.width, burned_amounts.height, first_replicate, n_replicates
+  };
+  std::vector<uint32_t> counts(burned_amounts.elems.begin(), burned_amounts.elems.end());
+
+  std::ofstream file(temporary_name, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(counts.data()), counts.size() * sizeof(uint32_t));
+  file.close();
+  if (!file || rename(temporary_name.c_str(), final_name.c_str()) != 0) {
+    std::remove(temporary_name.c_str());
+    throw std::runtime_error("Can't write result cache file " + final_name);
+  }
+}
+
+Matrix<size_t> cached_burned_amounts_per_cell(
+    ResultCache& cache, const LandscapeSoA& landscape,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit,
+    size_t n_replicates, std::string output_filename_suffix
+) {
+  std::string key = ResultCache::key(
+      landscape_hash(landscape.view()), ignition_cells, params, distance, elevation_mean,
+      elevation_sd, upper_limit
+  );
+
+  Matrix<size_t> burned_amounts(landscape.width, landscape.height);
+  // Found on the first miss, and shared by every batch simulated
+  std::optional<CropWindow> window;
+  EnsemblePerf perf;
+  for (size_t first = 0; first < n_replicates; first += cache.batch_size()) {
+    size_t count = std::min(cache.batch_size(), n_replicates - first);
+
+    std::optional<Matrix<size_t>> batch;
+    {
+      TRACE_SPAN("result_cache_load", "io", "first_replicate", first);
+      batch = cache.load(key, first, count, landscape.width, landscape.height);
+    }
+    if (batch) {
+      cache.hits++;
+    } else {
+      cache.misses++;
+      if (!window) {
+        window = reachable_window(landscape, ignition_cells);
+      }
+      batch = simulate_burned_amounts(
+          landscape.view(), *window, ignition_cells, params, distance, elevation_mean,
+          elevation_sd, upper_limit, count, perf, nullptr, first
+      );
+      cache.store(key, first, count, *batch);
+    }
+
+    for (size_t idx = 0; idx < burned_amounts.elems.size(); idx++) {
+      burned_amounts.elems[idx] += batch->elems[idx];
+    }
+  }
+  if (perf.n_replicates > 0) {
+    report_ensemble_perf(perf, landscape.width * landscape.height, output_filename_suffix);
+  }
+  return burned_amounts;
+}
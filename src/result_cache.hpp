@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+#include "matrix.hpp"
+#include "spread_functions.cuh"
+
+// Bump whenever `simulate_fire` changes the fires it produces for a given seed, so that results of
+// the previous engine are not served from the cache
+constexpr uint32_t SPREAD_ENGINE_VERSION = 1;
+
+/* Content-addressed cache of burned amounts.
+ *
+ * Results are stored in batches of `batch_size` consecutive replicates, one file per batch named
+ * after the key of the configuration (hash of the landscape, ignition cells, parameters, model
+ * constants and engine version) and the replicate range. Asking for `n_replicates` reuses every
+ * batch already in the cache and only simulates the missing ones, e.g. raising the replicate count
+ * only simulates the new replicates.
+ */
+class ResultCache {
+public:
+  ResultCache(std::string directory, size_t batch_size = 25);
+
+  static std::string key(
+      uint64_t landscape_hash, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+      const SimulationParams& params, float distance, float elevation_mean, float elevation_sd,
+      float upper_limit
+  );
+
+  std::optional<Matrix<size_t>> load(
+      const std::string& key, size_t first_replicate, size_t n_replicates, size_t width,
+      size_t height
+  ) const;
+  void store(
+      const std::string& key, size_t first_replicate, size_t n_replicates,
+      const Matrix<size_t>& burned_amounts
+  ) const;
+
+  size_t batch_size() const {
+    return batch;
+  }
+
+  size_t hits = 0;
+  size_t misses = 0;
+
+private:
+  std::string filename(const std::string& key, size_t first_replicate, size_t n_replicates) const;
+
+  std::string directory;
+  size_t batch;
+};
+
+// `burned_amounts_per_cell` through `cache`. The batches that miss are simulated and the perf of all
+// of them is reported once.
+Matrix<size_t> cached_burned_amounts_per_cell(
+    ResultCache& cache, const LandscapeSoA& landscape,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit,
+    size_t n_replicates, std::string output_filename_suffix
+);
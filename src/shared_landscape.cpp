@@ -0,0 +1,138 @@
+#include "shared_landscape.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t SEGMENT_MAGIC = 0x46495245534f4131; // "FIRESOA1"
+
+struct SegmentHeader {
+  uint64_t magic;
+  uint64_t width;
+  uint64_t height;
+};
+
+// Byte offsets of each layer inside the segment, every layer starts on a cache line
+struct SegmentLayout {
+  size_t elevation, fwi, aspect, vegetation_type, wind_dir, burnable, total;
+};
+
+size_t align_up(size_t offset) {
+  return (offset + 63) & ~size_t(63);
+}
+
+SegmentLayout segment_layout(size_t width, size_t height) {
+  size_t n_cells = width * height;
+  SegmentLayout layout;
+  layout.elevation = align_up(sizeof(SegmentHeader));
+  layout.fwi = align_up(layout.elevation + n_cells * sizeof(float));
+  layout.aspect = align_up(layout.fwi + n_cells * sizeof(float));
+  layout.vegetation_type = align_up(layout.aspect + n_cells * sizeof(float));
+  layout.wind_dir = align_up(layout.vegetation_type + n_cells * sizeof(float));
+  layout.burnable = align_up(layout.wind_dir + n_cells * sizeof(float));
+  layout.total = layout.burnable + n_cells * sizeof(uint8_t);
+  return layout;
+}
+
+} // namespace
+
+SharedLandscape::SharedLandscape(std::string name, void* data, size_t size, bool owner)
+    : segment_name(name), data(data), size(size), owner(owner) {}
+
+SharedLandscape::SharedLandscape(SharedLandscape&& other)
+    : segment_name(other.segment_name), data(other.data), size(other.size), owner(other.owner) {
+  other.data = nullptr;
+  other.owner = false;
+}
+
+SharedLandscape::~SharedLandscape() {
+  if (data) {
+    munmap(data, size);
+  }
+  if (owner) {
+    shm_unlink(segment_name.c_str());
+  }
+}
+
+SharedLandscape SharedLandscape::create(const LandscapeSoA& landscape, std::string name) {
+  SegmentLayout layout = segment_layout(landscape.width, landscape.height);
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw std::runtime_error("Can't create shared memory segment " + name);
+  }
+  if (ftruncate(fd, layout.total) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Can't resize shared memory segment " + name);
+  }
+  void* data = mmap(nullptr, layout.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Can't map shared memory segment " + name);
+  }
+
+  char* base = static_cast<char*>(data);
+  size_t n_cells = landscape.width * landscape.height;
+  SegmentHeader header = { SEGMENT_MAGIC, landscape.width, landscape.height };
+  std::memcpy(base, &header, sizeof(header));
+  std::memcpy(base + layout.elevation, landscape.elevation.data(), n_cells * sizeof(float));
+  std::memcpy(base + layout.fwi, landscape.fwi.data(), n_cells * sizeof(float));
+  std::memcpy(base + layout.aspect, landscape.aspect.data(), n_cells * sizeof(float));
+  std::memcpy(
+      base + layout.vegetation_type, landscape.vegetation_type.data(), n_cells * sizeof(float)
+  );
+  std::memcpy(base + layout.wind_dir, landscape.wind_dir.data(), n_cells * sizeof(float));
+  std::memcpy(base + layout.burnable, landscape.burnable.data(), n_cells * sizeof(uint8_t));
+
+  return SharedLandscape(name, data, layout.total, true);
+}
+
+SharedLandscape SharedLandscape::open(std::string name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Can't open shared memory segment " + name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SegmentHeader)) {
+    close(fd);
+    throw std::runtime_error("Invalid shared memory segment " + name);
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Can't map shared memory segment " + name);
+  }
+
+  SharedLandscape shared(name, data, st.st_size, false);
+  const SegmentHeader* header = static_cast<const SegmentHeader*>(data);
+  if (header->magic != SEGMENT_MAGIC ||
+      segment_layout(header->width, header->height).total > size_t(st.st_size)) {
+    throw std::runtime_error("Invalid shared memory segment " + name);
+  }
+  return shared;
+}
+
+LandscapeView SharedLandscape::view() const {
+  const char* base = static_cast<const char*>(data);
+  const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(base);
+  SegmentLayout layout = segment_layout(header->width, header->height);
+  return {
+    header->width,
+    header->height,
+    reinterpret_cast<const float*>(base + layout.elevation),
+    reinterpret_cast<const float*>(base + layout.fwi),
+    reinterpret_cast<const float*>(base + layout.aspect),
+    reinterpret_cast<const float*>(base + layout.vegetation_type),
+    reinterpret_cast<const float*>(base + layout.wind_dir),
+    reinterpret_cast<const uint8_t*>(base + layout.burnable),
+  };
+}
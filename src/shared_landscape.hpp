@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "landscape.hpp"
+
+/* A landscape stored in a POSIX shared-memory segment (shm_open + mmap).
+ *
+ * The process that loads the landscape creates the segment once; other processes (typically
+ * forked workers) open it by name and map it read-only, so every process reads the same physical
+ * pages instead of parsing and holding its own copy.
+ */
+class SharedLandscape {
+public:
+  // Creates the segment `name` (must start with '/') and copies the layers of `landscape` into it.
+  // The segment is unlinked when the creating object is destroyed.
+  static SharedLandscape create(const LandscapeSoA& landscape, std::string name);
+
+  // Maps an existing segment read-only
+  static SharedLandscape open(std::string name);
+
+  SharedLandscape(SharedLandscape&& other);
+  SharedLandscape(const SharedLandscape&) = delete;
+  SharedLandscape& operator=(const SharedLandscape&) = delete;
+  ~SharedLandscape();
+
+  LandscapeView view() const;
+
+  const std::string& name() const {
+    return segment_name;
+  }
+
+private:
+  SharedLandscape(std::string name, void* data, size_t size, bool owner);
+
+  std::string segment_name;
+  void* data;
+  size_t size;
+  bool owner;
+};
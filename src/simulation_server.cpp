@@ -0,0 +1,338 @@
+#include "simulation_server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+namespace {
+
+constexpr size_t MAX_REQUEST_LENGTH = 1 << 20;
+// Time a client has to send its request line
+constexpr std::chrono::seconds REQUEST_TIMEOUT(2);
+
+void send_all(int client, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return; // the client went away, nothing else to do
+    }
+    sent += n;
+  }
+}
+
+// A connection whose request line hasn't fully arrived yet
+struct PendingConnection {
+  int client;
+  std::string line;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+// Reads what `connection` has sent so far without blocking. Returns whether its request is
+// complete: a newline arrived (the line is cut there), the client closed or the line is too long.
+bool read_available(PendingConnection& connection) {
+  char buffer[4096];
+  while (connection.line.size() < MAX_REQUEST_LENGTH) {
+    ssize_t n = recv(connection.client, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return false;
+    }
+    if (n <= 0) {
+      return true;
+    }
+    connection.line.append(buffer, n);
+    size_t end = connection.line.find('\n');
+    if (end != std::string::npos) {
+      connection.line.resize(end);
+      return true;
+    }
+  }
+  return true;
+}
+
+// Burned amounts of the replicates of `request`, in the response format
+std::string simulate_request(
+    const SimulationRequest& request, const PreparedLandscape& landscape, float upper_limit,
+    CpuFireState& state, std::vector<uint32_t>& counts, std::vector<size_t>& touched
+) {
+  LandscapeView view = landscape.layers.view();
+  DerivedView derived = landscape.derived.view();
+  for (auto [x, y] : request.ignition_cells) {
+    if (x >= view.width || y >= view.height) {
+      throw std::runtime_error("Ignition cell outside the landscape");
+    }
+  }
+
+  size_t n_cells = view.width * view.height;
+  if (counts.size() < n_cells) {
+    counts.resize(n_cells, 0);
+  }
+  for (size_t i = request.first_replicate; i < request.first_replicate + request.n_replicates; i++) {
+    restart_fire_cpu(state, view, request.ignition_cells, replicate_seed(i));
+    while (advance_fire_step_cpu(state, view, derived, request.params, upper_limit)) {
+    }
+    for (size_t idx : state.burned_ids) {
+      if (counts[idx]++ == 0) {
+        touched.push_back(idx);
+      }
+    }
+  }
+
+  std::ostringstream response;
+  response << "ok " << view.width << " " << view.height << " " << request.n_replicates << " "
+           << touched.size() << "\n";
+  for (size_t idx : touched) {
+    response << idx << " " << counts[idx] << "\n";
+    counts[idx] = 0;
+  }
+  touched.clear();
+  return response.str();
+}
+
+// Whether `prefix` stays inside the directory it is relative to
+bool relative_landscape_prefix(const std::string& prefix) {
+  if (prefix.empty() || prefix[0] == '/') {
+    return false;
+  }
+  std::istringstream components(prefix);
+  std::string component;
+  while (std::getline(components, component, '/')) {
+    if (component == "..") {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+SimulationRequest parse_simulation_request(const std::string& line) {
+  std::istringstream fields(line);
+  SimulationRequest request;
+  request.client = -1;
+  SimulationParams& params = request.params;
+  // Signed, so that "-1" is rejected instead of wrapping around
+  long long first_replicate, n_replicates;
+  fields >> request.landscape >> first_replicate >> n_replicates >> params.independent_pred >> params.wind_pred >> params.elevation_pred >> params.slope_pred >>
+      params.subalpine_pred >> params.wet_pred >> params.dry_pred >> params.fwi_pred >>
+      params.aspect_pred;
+  if (!fields) {
+    throw std::runtime_error(
+        "Expected: simulate <landscape_prefix> <first_replicate> <n_replicates> <9 params> <x0> <y0> ..."
+    );
+  }
+  if (!relative_landscape_prefix(request.landscape)) {
+    throw std::runtime_error("The landscape prefix must be relative to the data directory");
+  }
+  if (first_replicate < 0 || n_replicates < 1 ||
+      size_t(n_replicates) > MAX_REQUEST_REPLICATES) {
+    throw std::runtime_error(
+        "Expected a first replicate >= 0 and between 1 and " +
+        std::to_string(MAX_REQUEST_REPLICATES) + " replicates"
+    );
+  }
+  // Replicate numbers are ints, see replicate_seed
+  if (first_replicate > std::numeric_limits<int>::max() - n_replicates) {
+    throw std::runtime_error("Replicate number out of range");
+  }
+  request.first_replicate = first_replicate;
+  request.n_replicates = n_replicates;
+
+  size_t x, y;
+  while (fields >> x) {
+    if (!(fields >> y)) {
+      throw std::runtime_error("Ignition cells must be pairs of coordinates");
+    }
+    request.ignition_cells.push_back({ x, y });
+  }
+  if (!fields.eof()) {
+    throw std::runtime_error("Invalid ignition cell");
+  }
+  if (request.ignition_cells.empty()) {
+    throw std::runtime_error("A simulation needs ignition cells");
+  }
+  return request;
+}
+
+SimulationServer::SimulationServer(
+    std::string socket_path, std::string data_directory, LandscapeCache& cache,
+    float upper_limit, size_t n_workers, size_t queue_capacity, size_t max_batch
+)
+    : socket_path(socket_path), data_directory(data_directory), cache(cache),
+      upper_limit(upper_limit),
+      max_batch(std::max<size_t>(max_batch, 1)), queue(queue_capacity),
+      workers(std::max<size_t>(n_workers, 1)) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + socket_path);
+  }
+  std::strcpy(address.sun_path, socket_path.c_str());
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw std::runtime_error("Can't create socket");
+  }
+  unlink(socket_path.c_str()); // left behind by a previous daemon
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listener, 128) != 0) {
+    close(listener);
+    throw std::runtime_error("Can't listen on " + socket_path);
+  }
+}
+
+SimulationServer::~SimulationServer() {
+  close(listener);
+  unlink(socket_path.c_str());
+}
+
+void SimulationServer::run() {
+  for (size_t w = 0; w < workers.size(); w++) {
+    workers[w] = std::thread(&SimulationServer::serve, this, w);
+  }
+
+  // Request lines are read as they arrive from every pending connection at once, so a slow or idle
+  // client can't hold up the others
+  std::vector<PendingConnection> pending;
+  std::vector<pollfd> polled;
+  while (!stopping) {
+    polled.assign(1, { listener, POLLIN, 0 });
+    for (const PendingConnection& connection : pending) {
+      polled.push_back({ connection.client, POLLIN, 0 });
+    }
+    // Woken up regularly to notice `stop` and the connections past their deadline
+    if (poll(polled.data(), polled.size(), 200) < 0) {
+      continue;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::vector<PendingConnection> still_pending;
+    for (size_t c = 0; c < pending.size(); c++) {
+      PendingConnection& connection = pending[c];
+      // The request so far is answered (with an error, unless complete) once the deadline passes
+      bool complete = (polled[c + 1].revents && read_available(connection)) ||
+                      now >= connection.deadline;
+      if (complete) {
+        handle_request(connection.client, connection.line);
+      } else {
+        still_pending.push_back(std::move(connection));
+      }
+    }
+    pending = std::move(still_pending);
+
+    if (polled[0].revents & POLLIN) {
+      int client = accept(listener, nullptr, nullptr);
+      if (client >= 0) {
+        pending.push_back({ client, "", now + REQUEST_TIMEOUT });
+      }
+    }
+  }
+  for (const PendingConnection& connection : pending) {
+    close(connection.client);
+  }
+
+  queue.close();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+void SimulationServer::stop() {
+  stopping = true;
+}
+
+void SimulationServer::handle_request(int client, const std::string& line) {
+  std::istringstream fields(line);
+  std::string command;
+  fields >> command;
+  try {
+    if (command == "simulate") {
+      std::string rest;
+      std::getline(fields, rest);
+      SimulationRequest request = parse_simulation_request(rest);
+      request.landscape = data_directory + "/" + request.landscape;
+      request.client = client;
+      if (!queue.push(std::move(request))) {
+        throw std::runtime_error("The daemon is stopping");
+      }
+      return; // answered by a worker
+    } else if (command == "stats") {
+      LandscapeCache::Stats stats = cache.stats();
+      std::ostringstream response;
+      response << "ok " << stats.n_landscapes << " landscapes, " << stats.bytes << " bytes, "
+               << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions
+               << " evictions, " << served << " requests served\n";
+      send_all(client, response.str());
+    } else {
+      throw std::runtime_error("Unknown command '" + command + "' (expected simulate or stats)");
+    }
+  } catch (const std::runtime_error& e) {
+    send_all(client, std::string("error ") + e.what() + "\n");
+  }
+  close(client);
+}
+
+void SimulationServer::serve(int worker) {
+  // Reused by every request of this worker
+  CpuFireState state = { 0, { EdgeStream::INDEPENDENT, 0, 1 }, {}, {}, {}, 0, 0 };
+  std::vector<uint32_t> counts;
+  std::vector<size_t> touched;
+
+  while (std::optional<SimulationRequest> first = queue.pop()) {
+    std::vector<SimulationRequest> batch;
+    batch.push_back(std::move(*first));
+    std::string name = batch[0].landscape;
+    for (SimulationRequest& request : queue.take_if(
+             [&](const SimulationRequest& queued) { return queued.landscape == name; },
+             max_batch - 1
+         )) {
+      batch.push_back(std::move(request));
+    }
+    TRACE_SPAN("serve_batch", "simulation", "worker", worker);
+
+    std::shared_ptr<const PreparedLandscape> landscape;
+    std::string error;
+    try {
+      landscape = cache.get(name);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+
+    for (SimulationRequest& request : batch) {
+      std::string response;
+      try {
+        if (!landscape) {
+          throw std::runtime_error(error);
+        }
+        response = simulate_request(request, *landscape, upper_limit, state, counts, touched);
+      } catch (const std::exception& e) {
+        response = std::string("error ") + e.what() + "\n";
+        for (size_t idx : touched) {
+          counts[idx] = 0;
+        }
+        touched.clear();
+      }
+      send_all(request.client, response);
+      close(request.client);
+      served++;
+    }
+  }
+}
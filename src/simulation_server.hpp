@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "ignition_cells.hpp"
+#include "landscape_cache.hpp"
+#include "spread_functions.cuh"
+
+/* Simulation daemon listening on a local UNIX socket.
+ *
+ * Every connection sends one request line and receives one response:
+ *
+ *   simulate <landscape_prefix> <first_replicate> <n_replicates> <9 params> <x0> <y0> [<x1> <y1> ...]
+ *   stats
+ *
+ * The landscape prefix is relative to the data directory of the daemon, which is the only place
+ * it reads landscapes from (and writes their derived layers to): absolute prefixes and prefixes
+ * with a `..` component are rejected. A request has at most MAX_REQUEST_REPLICATES replicates, and
+ * its last replicate must be a valid replicate number. The parameters follow the order of
+ * SimulationParams. A simulation answers
+ *
+ *   ok <width> <height> <n_replicates> <n_cells>
+ *
+ * followed by `n_cells` lines `<cell> <times burned>`, one per cell that burned at least once
+ * (cell = x + y * width). Errors answer `error <message>`.
+ *
+ * The accepting thread polls the pending connections and parses each request line once it has
+ * arrived (clients have 2 s to send it) into a bounded queue served by `n_workers` threads on the
+ * host engine (replicate i uses the seed of `simulate_fire_cpu`). A worker takes a request together
+ * with the other queued requests for the same landscape, up to `max_batch`, and serves them with a
+ * single cache lookup and the same fire buffers. Landscapes come from a LandscapeCache, so only the
+ * first request for a landscape pays for reading it.
+ */
+
+struct SimulationRequest {
+  int client;
+  std::string landscape;
+  size_t first_replicate, n_replicates;
+  SimulationParams params;
+  IgnitionCells ignition_cells;
+};
+
+constexpr size_t MAX_REQUEST_REPLICATES = 100000;
+
+// Parses the fields after "simulate", throws std::runtime_error if they are invalid. The landscape
+// is left relative to the data directory.
+SimulationRequest parse_simulation_request(const std::string& line);
+
+class SimulationServer {
+public:
+  SimulationServer(
+      std::string socket_path, std::string data_directory, LandscapeCache& cache,
+      float upper_limit, size_t n_workers, size_t queue_capacity = 256, size_t max_batch = 32
+  );
+  ~SimulationServer();
+
+  SimulationServer(const SimulationServer&) = delete;
+  SimulationServer& operator=(const SimulationServer&) = delete;
+
+  // Accepts requests until `stop` is called, then waits for the queued ones
+  void run();
+
+  // Safe to call from another thread
+  void stop();
+
+private:
+  // Answers `stats` or queues a simulation for the workers
+  void handle_request(int client, const std::string& line);
+  void serve(int worker);
+
+  std::string socket_path;
+  std::string data_directory;
+  LandscapeCache& cache;
+  float upper_limit;
+  size_t max_batch;
+  int listener;
+  std::atomic<bool> stopping{ false };
+  std::atomic<size_t> served{ 0 };
+  BoundedQueue<SimulationRequest> queue;
+  std::vector<std::thread> workers;
+};
@@ -8,9 +8,14 @@
 #include <iostream>
 #include <array>
 #include <random>
+#include <unordered_set>
+#include <utility>
 
 #include "fires.hpp"
 #include "landscape.hpp"
+#include "memory_accounting.hpp"
+#include "spread_traits.hpp"
+#include "trace.hpp"
 
 #include <cuda_runtime.h>
 #include <curand_kernel.h>
@@ -25,8 +30,13 @@ struct DeviceBuffers {
     int* next_frontier_count;
     int* done_flag;
     int* burned_bin;
+    int* burned_list;
+    int* burned_count;
     int* iteration_map;
     unsigned int* processed_cells;
+    // Only allocated when recording steps
+    int* step_ends;
+    int* n_steps;
 
     float* elevation;
     float* fwi;
@@ -48,10 +58,17 @@ struct FireKernelParams {
     const uint8_t* burnable;
 
     int* burned_bin;
+    // Linear indices of the burned cells, appended as they burn
+    int* burned_list;
+    int* burned_count;
     int width;
     int height;
+    // Row length of the layers, burned_bin and iteration_map: width + 2 with a halo
+    int pitch;
 
     unsigned int* processed_cells;
+    int* step_ends;
+    int* n_steps;
     const SimulationParams* params;
 
     float distance;
@@ -88,50 +105,11 @@ __global__ void init_rng_kernel(curandState* states, int width, int height, int
 }
 
 
-__device__ void spread_probability(
-    float burning_elevation,
-    float burning_wind_direction,
-    const float* elevations,
-    const float* vegetation_types,
-    const float* fwis,
-    const float* aspects,
-    const float* upper_limits,
-    const SimulationParams* params,
-    float distance,
-    float elevation_mean,
-    float elevation_sd,
-    float* probs_out
-) {
-    float fwi_pred = params->fwi_pred;
-    float aspect_pred = params->aspect_pred;
-    float wind_pred = params->wind_pred;
-    float elevation_pred = params->elevation_pred;
-    float slope_pred = params->slope_pred;
-    float independent_pred = params->independent_pred;
-    for (int n = 0; n < 8; n++) {
-        float slope_term = __sinf(atanf((elevations[n] - burning_elevation) / distance));
-        float wind_term = __cosf(d_angles[n] - burning_wind_direction);
-        float elev_term = (elevations[n] - elevation_mean) / elevation_sd;
-
-        float linpred = independent_pred;
-
-        if ((int)vegetation_types[n] == SUBALPINE) {
-            linpred += params->subalpine_pred;
-        } else if ((int)vegetation_types[n] == WET) {
-            linpred += params->wet_pred;
-        } else if ((int)vegetation_types[n] == DRY) {
-            linpred += params->dry_pred;
-        }
-
-        linpred += fwi_pred * fwis[n];
-        linpred += aspect_pred * aspects[n];
-        linpred += wind_term * wind_pred + elev_term * elevation_pred + slope_term * slope_pred;
-
-        probs_out[n] = upper_limits[n] / (1.0f + __expf(-linpred));
-    }
-}
-
-
+// Persistent kernel specialized on the groups of terms with non-zero coefficients (`Terms`, see
+// spread_traits.hpp), on whether the layers have a non-burnable halo (no bounds checks), and on
+// whether step ends and processed cells are recorded. Cells in the frontier, burned_list and the
+// rng states use unpadded indices.
+template <unsigned Terms, bool Halo, bool RecordSteps, bool CountMetrics>
 __global__ void fire_persistent_kernel(
     FireKernelParams args,
     int* frontier_0, int* frontier_1,
@@ -143,7 +121,6 @@ __global__ void fire_persistent_kernel(
     int* done_flag,
     curandState* rng_states
 ) {
-    unsigned long long start = clock64();
     const float* elevation = args.elevation;
     const float* fwi = args.fwi;
     const float* aspect = args.aspect;
@@ -154,15 +131,16 @@ __global__ void fire_persistent_kernel(
     int* burned_bin = args.burned_bin;
     int width = args.width;
     int height = args.height;
-    const SimulationParams* params = args.params;
+    int pitch = args.pitch;
+    const SimulationParams params = *args.params;
 
     float distance = args.distance;
     float upper_limit = args.upper_limit;
     float elevation_mean = args.elevation_mean;
     float elevation_sd = args.elevation_sd;
-    
+
     unsigned int local_processed_cells = 0;
-    
+
     int tid = blockIdx.x * blockDim.x + threadIdx.x;
     while (!*done_flag) {
         int frontier_len = *frontier_size;
@@ -171,66 +149,56 @@ __global__ void fire_persistent_kernel(
             int i = frontier_0[idx];
             int j = frontier_1[idx];
             int center_idx = j * width + i;
+            int center_cell = Halo ? (j + 1) * pitch + i + 1 : center_idx;
 
             curandState local_state = rng_states[center_idx];
 
-            float elev_c = elevation[center_idx];
-            float wind_c = wind_dir[center_idx];
-
-            int n_coords_0[8], n_coords_1[8];
-            int n_indices[8];
-            uint8_t n_out_flags[8];
-            float n_elev[8], n_fwi[8], n_asp[8], n_veg[8], n_burn[8], n_upper[8];
+            float elev_c = 0.0f, wind_c = 0.0f;
+            if (Terms & TOPOGRAPHY_TERMS) {
+                elev_c = elevation[center_cell];
+                wind_c = wind_dir[center_cell];
+            }
+            if (CountMetrics) {
+                // Neighbors inside the landscape
+                local_processed_cells += (1 + (i > 0) + (i + 1 < width)) * (1 + (j > 0) + (j + 1 < height)) - 1;
+            }
 
             for (int n = 0; n < 8; ++n) {
                 int ni = i + d_moves[n][0];
                 int nj = j + d_moves[n][1];
-                n_coords_0[n] = ni;
-                n_coords_1[n] = nj;
-
-                if (ni < 0 || nj < 0 || ni >= width || nj >= height) {
-                    n_out_flags[n] = 1;
-                    n_indices[n] = 0;
-                    n_elev[n] = n_fwi[n] = n_asp[n] = n_veg[n] = 0.0f;
-                    n_burn[n] = 0;
-                } else {
-                    int n_idx = nj * width + ni;
-                    n_out_flags[n] = 0;
-                    n_indices[n] = n_idx;
-                    n_elev[n] = elevation[n_idx];
-                    n_fwi[n] = fwi[n_idx];
-                    n_asp[n] = aspect[n_idx];
-                    n_veg[n] = vegetation_type[n_idx];
-                    n_burn[n] = burnable[n_idx];
-                    if (!n_out_flags[n]) {
-                        ++local_processed_cells;
-                    }
-                }
-
-                uint8_t burnable_mask = (!burned_bin[n_indices[n]] && n_burn[n]);
-                uint8_t valid_mask = !n_out_flags[n] && burnable_mask;
-                n_upper[n] = valid_mask * upper_limit;
-            }
-
-            float n_probs[8];
-            spread_probability(
-                elev_c, wind_c,
-                n_elev, n_veg, n_fwi, n_asp, n_upper,
-                params, distance, elevation_mean, elevation_sd,
-                n_probs
-            );
+                int n_cell = center_cell + d_moves[n][0] + d_moves[n][1] * pitch;
+                bool valid = (Halo || (ni >= 0 && nj >= 0 && ni < width && nj < height)) &&
+                             burnable[n_cell] && !burned_bin[n_cell];
 
-            for (int n = 0; n < 8; ++n) {
+                // Every cell draws once per neighbor, valid or not, so the stream doesn't depend on
+                // the variant
                 float rnd = curand_uniform(&local_state);
-                if (rnd < n_probs[n]) {
-                    if (n_indices[n] >= 0 && !n_out_flags[n] && n_burn[n]) {
-                        if (atomicCAS(&iteration_map[n_indices[n]], 0, iteration_tag) == 0) {
-                            burned_bin[n_indices[n]] = 1;
-                            int pos = atomicAdd(next_frontier_count, 1);
-                            next_frontier_0[pos] = n_coords_0[n];
-                            next_frontier_1[pos] = n_coords_1[n];
-                        }
-                    }
+                if (!valid) {
+                    continue;
+                }
+
+                float slope_term = 0.0f, wind_term = 0.0f, elev_term = 0.0f;
+                if (Terms & TOPOGRAPHY_TERMS) {
+                    float elev_n = elevation[n_cell];
+                    slope_term = __sinf(atanf((elev_n - elev_c) / distance));
+                    wind_term = __cosf(d_angles[n] - wind_c);
+                    elev_term = (elev_n - elevation_mean) / elevation_sd;
+                }
+                float linpred = linear_predictor<Terms>(
+                    params,
+                    (Terms & VEGETATION_TERMS) ? vegetation_type[n_cell] : 0.0f,
+                    (Terms & COVARIATE_TERMS) ? fwi[n_cell] : 0.0f,
+                    (Terms & COVARIATE_TERMS) ? aspect[n_cell] : 0.0f,
+                    wind_term, elev_term, slope_term
+                );
+                float prob = upper_limit / (1.0f + __expf(-linpred));
+
+                if (rnd < prob && atomicCAS(&iteration_map[n_cell], 0, iteration_tag) == 0) {
+                    burned_bin[n_cell] = 1;
+                    args.burned_list[atomicAdd(args.burned_count, 1)] = nj * width + ni;
+                    int pos = atomicAdd(next_frontier_count, 1);
+                    next_frontier_0[pos] = ni;
+                    next_frontier_1[pos] = nj;
                 }
             }
             rng_states[center_idx] = local_state;
@@ -243,6 +211,9 @@ __global__ void fire_persistent_kernel(
             *frontier_size = count;
             *next_frontier_count = 0;
             *done_flag = (count == 0);
+            if (RecordSteps && count > 0) {
+                args.step_ends[(*args.n_steps)++] = *args.burned_count;
+            }
         }
 
         __syncthreads();
@@ -255,16 +226,16 @@ __global__ void fire_persistent_kernel(
         next_frontier_1 = tmp1;
     }
 
-    if (local_processed_cells)
+    if (CountMetrics && local_processed_cells)
         atomicAdd(args.processed_cells, local_processed_cells);
-    unsigned long long end = clock64();
 }
 
 
 ////////////////////////////// HOST //////////////////////////////
 
 
-DeviceBuffers allocate_device_memory(size_t MAX_CELLS) {
+// `LAYER_CELLS` is the size of the layers, burned_bin and iteration_map, including the halo if any
+DeviceBuffers allocate_device_memory(size_t MAX_CELLS, size_t LAYER_CELLS, const SpreadOptions& options) {
     DeviceBuffers buf = {};
     cudaMalloc(&buf.frontier_0, MAX_CELLS * sizeof(int));
     cudaMalloc(&buf.frontier_1, MAX_CELLS * sizeof(int));
@@ -273,17 +244,24 @@ DeviceBuffers allocate_device_memory(size_t MAX_CELLS) {
     cudaMalloc(&buf.frontier_size, sizeof(int));
     cudaMalloc(&buf.next_frontier_count, sizeof(int));
     cudaMalloc(&buf.done_flag, sizeof(int));
-    cudaMalloc(&buf.burned_bin, MAX_CELLS * sizeof(int));
+    cudaMalloc(&buf.burned_bin, LAYER_CELLS * sizeof(int));
+    cudaMalloc(&buf.burned_list, MAX_CELLS * sizeof(int));
+    cudaMalloc(&buf.burned_count, sizeof(int));
     cudaMalloc(&buf.processed_cells, sizeof(unsigned int));
-    cudaMalloc(&buf.iteration_map, MAX_CELLS * sizeof(int));
-    cudaMemset(buf.iteration_map, 0, MAX_CELLS * sizeof(int));
+    cudaMalloc(&buf.iteration_map, LAYER_CELLS * sizeof(int));
+    cudaMemset(buf.iteration_map, 0, LAYER_CELLS * sizeof(int));
+    if (options.record_steps) {
+        // A step burns at least one cell, plus the entry of the ignition
+        cudaMalloc(&buf.step_ends, (MAX_CELLS + 1) * sizeof(int));
+        cudaMalloc(&buf.n_steps, sizeof(int));
+    }
 
-    cudaMalloc(&buf.elevation, MAX_CELLS * sizeof(float));
-    cudaMalloc(&buf.fwi, MAX_CELLS * sizeof(float));
-    cudaMalloc(&buf.aspect, MAX_CELLS * sizeof(float));
-    cudaMalloc(&buf.wind_dir, MAX_CELLS * sizeof(float));
-    cudaMalloc(&buf.vegetation_type, MAX_CELLS * sizeof(float));
-    cudaMalloc(&buf.burnable, MAX_CELLS * sizeof(uint8_t));
+    cudaMalloc(&buf.elevation, LAYER_CELLS * sizeof(float));
+    cudaMalloc(&buf.fwi, LAYER_CELLS * sizeof(float));
+    cudaMalloc(&buf.aspect, LAYER_CELLS * sizeof(float));
+    cudaMalloc(&buf.wind_dir, LAYER_CELLS * sizeof(float));
+    cudaMalloc(&buf.vegetation_type, LAYER_CELLS * sizeof(float));
+    cudaMalloc(&buf.burnable, LAYER_CELLS * sizeof(uint8_t));
 
     cudaMalloc(&buf.d_params, sizeof(SimulationParams));
     cudaMalloc(&buf.rng_states, MAX_CELLS * sizeof(curandState));
@@ -293,37 +271,64 @@ DeviceBuffers allocate_device_memory(size_t MAX_CELLS) {
 
 
 void copy_inputs_to_device(
-    const LandscapeSoA& landscape,
+    const LandscapeView& landscape,
     const std::vector<std::pair<size_t, size_t>>& ignition_cells,
     const SimulationParams& params,
     DeviceBuffers& buf,
     int n_col,
-    size_t MAX_CELLS
+    size_t LAYER_CELLS,
+    const SpreadOptions& options
 ) {
-    // Convert ignition to burned_bin
-    std::vector<int> burned_bin(MAX_CELLS, 0);
-    std::vector<int> h_frontier_0(MAX_CELLS, -1);
-    std::vector<int> h_frontier_1(MAX_CELLS, -1);
-
-    for (size_t i = 0; i < ignition_cells.size(); ++i) {
-        auto [x, y] = ignition_cells[i];
-        h_frontier_0[i] = x;
-        h_frontier_1[i] = y;
-        burned_bin[utils::INDEX(x, y, n_col)] = 1;
-    }
+    // With a halo every layer is copied one row and one column into its padded buffer. The host
+    // rows are `row_stride()` apart, so a window of a larger landscape is copied from its layers.
+    const size_t pitch = options.halo ? n_col + 2 : n_col;
+    const size_t first_cell = options.halo ? pitch + 1 : 0;
+    auto copy_layer = [&](auto* device, const auto* host) {
+        size_t cell_size = sizeof(*host);
+        cudaMemcpy2D(
+            device + first_cell, pitch * cell_size, host, landscape.row_stride() * cell_size,
+            n_col * cell_size, landscape.height, cudaMemcpyHostToDevice
+        );
+    };
 
-    int init_size = ignition_cells.size();
+    // Convert ignition to burned_bin; only the ignition cells are copied, the rest is a memset.
+    // A repeated ignition cell is burned once, as in restart_fire_cpu.
+    std::vector<int> h_frontier_0;
+    std::vector<int> h_frontier_1;
+    std::vector<int> h_burned_list;
+    std::unordered_set<int> ignited;
+    const int one = 1;
+
+    cudaMemset(buf.burned_bin, 0, LAYER_CELLS * sizeof(int));
+    for (auto [x, y] : ignition_cells) {
+        int idx = utils::INDEX(x, y, n_col);
+        if (!ignited.insert(idx).second) {
+            continue;
+        }
+        h_frontier_0.push_back(x);
+        h_frontier_1.push_back(y);
+        h_burned_list.push_back(idx);
+        cudaMemcpy(buf.burned_bin + first_cell + y * pitch + x, &one, sizeof(int), cudaMemcpyHostToDevice);
+    }
+    int init_size = h_burned_list.size();
 
     cudaMemcpy(buf.frontier_0, h_frontier_0.data(), init_size * sizeof(int), cudaMemcpyHostToDevice);
     cudaMemcpy(buf.frontier_1, h_frontier_1.data(), init_size * sizeof(int), cudaMemcpyHostToDevice);
     cudaMemcpy(buf.frontier_size, &init_size, sizeof(int), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.burned_bin, burned_bin.data(), MAX_CELLS * sizeof(int), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.elevation, landscape.elevation.data(), MAX_CELLS * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.fwi, landscape.fwi.data(), MAX_CELLS * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.aspect, landscape.aspect.data(), MAX_CELLS * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.wind_dir, landscape.wind_dir.data(), MAX_CELLS * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.vegetation_type, landscape.vegetation_type.data(), MAX_CELLS * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(buf.burnable, landscape.burnable.data(), MAX_CELLS * sizeof(uint8_t), cudaMemcpyHostToDevice);
+    cudaMemcpy(buf.burned_list, h_burned_list.data(), init_size * sizeof(int), cudaMemcpyHostToDevice);
+    cudaMemcpy(buf.burned_count, &init_size, sizeof(int), cudaMemcpyHostToDevice);
+    if (options.record_steps) {
+        cudaMemcpy(buf.step_ends, &init_size, sizeof(int), cudaMemcpyHostToDevice);
+        cudaMemcpy(buf.n_steps, &one, sizeof(int), cudaMemcpyHostToDevice);
+    }
+    // The halo is never burnable, the other layers are not read there
+    cudaMemset(buf.burnable, 0, LAYER_CELLS * sizeof(uint8_t));
+    copy_layer(buf.elevation, landscape.elevation);
+    copy_layer(buf.fwi, landscape.fwi);
+    copy_layer(buf.aspect, landscape.aspect);
+    copy_layer(buf.wind_dir, landscape.wind_dir);
+    copy_layer(buf.vegetation_type, landscape.vegetation_type);
+    copy_layer(buf.burnable, landscape.burnable);
     cudaMemcpy(buf.d_params, &params, sizeof(SimulationParams), cudaMemcpyHostToDevice);
 
     cudaMemset(buf.next_frontier_count, 0, sizeof(int));
@@ -337,50 +342,97 @@ void initialize_rng(DeviceBuffers& buf, int n_row, int n_col, int seed, int thre
 }
 
 
-void launch_kernel(DeviceBuffers& buf, FireKernelParams& args, int threads_per_block, int num_blocks) {
+// Bits of a kernel variant above the groups of terms
+constexpr unsigned HALO_VARIANT = 1 << 3;
+constexpr unsigned RECORD_STEPS_VARIANT = 1 << 4;
+constexpr unsigned COUNT_METRICS_VARIANT = 1 << 5;
+constexpr unsigned N_KERNEL_VARIANTS = 1 << 6;
+
+using KernelLauncher = void (*)(DeviceBuffers&, FireKernelParams&, int, int);
+
+template <unsigned Variant>
+void launch_variant(DeviceBuffers& buf, FireKernelParams& args, int threads_per_block, int num_blocks) {
     int iteration_tag = 1;
-    fire_persistent_kernel<<<num_blocks, threads_per_block>>>(
+    fire_persistent_kernel<
+        Variant & ALL_TERMS, bool(Variant & HALO_VARIANT), bool(Variant & RECORD_STEPS_VARIANT),
+        bool(Variant & COUNT_METRICS_VARIANT)><<<num_blocks, threads_per_block>>>(
         args,
         buf.frontier_0, buf.frontier_1, buf.frontier_size,
         buf.next_frontier_0, buf.next_frontier_1, buf.next_frontier_count,
         buf.iteration_map, iteration_tag,
         buf.done_flag, buf.rng_states
     );
+}
+
+template <unsigned... Variants>
+constexpr std::array<KernelLauncher, sizeof...(Variants)> kernel_launchers(
+    std::integer_sequence<unsigned, Variants...>
+) {
+    return { &launch_variant<Variants>... };
+}
+
+constexpr std::array<KernelLauncher, N_KERNEL_VARIANTS> KERNEL_LAUNCHERS =
+    kernel_launchers(std::make_integer_sequence<unsigned, N_KERNEL_VARIANTS>());
+
+
+// Runs the instantiation matching the parameters and the options
+void launch_kernel(
+    DeviceBuffers& buf, FireKernelParams& args, const SimulationParams& params,
+    const SpreadOptions& options, int threads_per_block, int num_blocks
+) {
+    unsigned variant = active_terms(params);
+    variant |= options.halo ? HALO_VARIANT : 0;
+    variant |= options.record_steps ? RECORD_STEPS_VARIANT : 0;
+    variant |= options.count_metrics ? COUNT_METRICS_VARIANT : 0;
+    KERNEL_LAUNCHERS[variant](buf, args, threads_per_block, num_blocks);
     cudaDeviceSynchronize();
 }
 
 
-Fire copy_results_from_device(
+// Only the list of burned cells is copied back (proportional to the fire, not to the grid), directly
+// into the storage of `fire`
+void copy_results_from_device(
     const DeviceBuffers& buf,
     size_t n_row,
-    size_t n_col
+    size_t n_col,
+    const SpreadOptions& options,
+    Fire& fire
 ) {
-    size_t MAX_CELLS = n_row * n_col;
+    fire.reset(n_col, n_row);
 
-    std::vector<int> burned_bin(MAX_CELLS);
-    cudaMemcpy(burned_bin.data(), buf.burned_bin, MAX_CELLS * sizeof(int), cudaMemcpyDeviceToHost);
+    int burned_count;
+    cudaMemcpy(&burned_count, buf.burned_count, sizeof(int), cudaMemcpyDeviceToHost);
 
-    std::vector<size_t> ids_0, ids_1;
-    for (size_t j = 0; j < n_row; ++j) {
-        for (size_t i = 0; i < n_col; ++i) {
-            if (burned_bin[utils::INDEX(i, j, n_col)]) {
-                ids_0.push_back(i);
-                ids_1.push_back(j);
-            }
-        }
+    fire.burned_cells.resize(burned_count);
+    static_assert(sizeof(uint32_t) == sizeof(int), "burned_list is copied as is");
+    cudaMemcpy(fire.burned_cells.data(), buf.burned_list, burned_count * sizeof(int), cudaMemcpyDeviceToHost);
+    for (uint32_t idx : fire.burned_cells) {
+        fire.burned_bits[idx >> 6] |= uint64_t(1) << (idx & 63);
+    }
+    if (options.record_steps) {
+        int n_steps;
+        cudaMemcpy(&n_steps, buf.n_steps, sizeof(int), cudaMemcpyDeviceToHost);
+        std::vector<int> step_ends(n_steps);
+        cudaMemcpy(step_ends.data(), buf.step_ends, n_steps * sizeof(int), cudaMemcpyDeviceToHost);
+        fire.burned_ids_steps.assign(step_ends.begin(), step_ends.end());
+    } else {
+        fire.burned_ids_steps.push_back(fire.burned_cells.size());
     }
 
-    unsigned int processed_cells;
-    cudaMemcpy(&processed_cells, buf.processed_cells, sizeof(unsigned int), cudaMemcpyDeviceToHost);
+    cudaMemcpy(&fire.processed_cells, buf.processed_cells, sizeof(unsigned int), cudaMemcpyDeviceToHost);
+}
 
-    return Fire{
-        n_col, n_row,
-        processed_cells,
-        0.0,
-        burned_bin,
-        ids_0, ids_1,
-        { ids_0.size() }
-    };
+
+size_t device_memory_bytes(size_t width, size_t height, const SpreadOptions& options) {
+    const size_t MAX_CELLS = width * height;
+    const size_t LAYER_CELLS = options.halo ? (width + 2) * (height + 2) : MAX_CELLS;
+    size_t bytes = MAX_CELLS * (5 * sizeof(int) + sizeof(curandState)) +
+                   LAYER_CELLS * (2 * sizeof(int) + 5 * sizeof(float) + sizeof(uint8_t)) +
+                   6 * sizeof(int) + sizeof(unsigned int) + sizeof(SimulationParams);
+    if (options.record_steps) {
+        bytes += (MAX_CELLS + 2) * sizeof(int);
+    }
+    return bytes;
 }
 
 
@@ -389,7 +441,9 @@ void free_device_memory(DeviceBuffers& buf) {
     cudaFree(buf.next_frontier_0); cudaFree(buf.next_frontier_1);
     cudaFree(buf.frontier_size); cudaFree(buf.next_frontier_count);
     cudaFree(buf.done_flag); cudaFree(buf.burned_bin);
+    cudaFree(buf.burned_list); cudaFree(buf.burned_count);
     cudaFree(buf.iteration_map); cudaFree(buf.processed_cells);
+    cudaFree(buf.step_ends); cudaFree(buf.n_steps);
 
     cudaFree(buf.elevation); cudaFree(buf.fwi); cudaFree(buf.aspect);
     cudaFree(buf.wind_dir); cudaFree(buf.vegetation_type); cudaFree(buf.burnable);
@@ -399,7 +453,7 @@ void free_device_memory(DeviceBuffers& buf) {
 
 
 Fire simulate_fire(
-    LandscapeSoA landscape,
+    const LandscapeSoA& landscape,
     size_t n_row, size_t n_col,
     const std::vector<std::pair<size_t, size_t>>& ignition_cells,
     SimulationParams params,
@@ -409,24 +463,74 @@ Fire simulate_fire(
     int n_replicate,
     float upper_limit = 1.0f
 ) {
+    LandscapeView view = landscape.view();
+    view.width = n_col;
+    view.height = n_row;
+    return simulate_fire(
+        view, ignition_cells, params, distance, elevation_mean, elevation_sd, n_replicate, upper_limit
+    );
+}
+
+
+Fire simulate_fire(
+    const LandscapeView& landscape,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params,
+    float distance,
+    float elevation_mean,
+    float elevation_sd,
+    int n_replicate,
+    float upper_limit
+) {
+    Fire fire = empty_fire(0, 0);
+    simulate_fire(
+        landscape, ignition_cells, params, distance, elevation_mean, elevation_sd, n_replicate,
+        upper_limit, fire
+    );
+    return fire;
+}
+
+
+void simulate_fire(
+    const LandscapeView& landscape,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params,
+    float distance,
+    float elevation_mean,
+    float elevation_sd,
+    int n_replicate,
+    float upper_limit,
+    Fire& fire,
+    SpreadOptions options
+) {
+    const size_t n_row = landscape.height;
+    const size_t n_col = landscape.width;
     const size_t MAX_CELLS = n_row * n_col;
+    const size_t pitch = options.halo ? n_col + 2 : n_col;
+    const size_t LAYER_CELLS = options.halo ? pitch * (n_row + 2) : MAX_CELLS;
     const int threads_per_block = 256;
     const int num_blocks = (MAX_CELLS + threads_per_block - 1) / threads_per_block;
 
-    cudaMemcpyToSymbol(d_angles, h_angles, sizeof(h_angles));
-    cudaMemcpyToSymbol(d_moves, h_moves, sizeof(h_moves));
+    DeviceBuffers buf;
+    MemoryUsage device_usage(MemoryComponent::DEVICE_BUFFERS);
+    {
+        TRACE_SPAN("setup_device", "simulation");
+        cudaMemcpyToSymbol(d_angles, h_angles, sizeof(h_angles));
+        cudaMemcpyToSymbol(d_moves, h_moves, sizeof(h_moves));
 
-    DeviceBuffers buf = allocate_device_memory(MAX_CELLS);
+        buf = allocate_device_memory(MAX_CELLS, LAYER_CELLS, options);
+        device_usage.set(device_memory_bytes(n_col, n_row, options));
 
-    copy_inputs_to_device(landscape, ignition_cells, params, buf, n_col, MAX_CELLS);
+        copy_inputs_to_device(landscape, ignition_cells, params, buf, n_col, LAYER_CELLS, options);
 
-    initialize_rng(buf, n_row, n_col, 123 + n_replicate, threads_per_block, num_blocks);
+        initialize_rng(buf, n_row, n_col, 123 + n_replicate, threads_per_block, num_blocks);
+    }
 
     FireKernelParams args = {
         buf.elevation, buf.fwi, buf.aspect, buf.wind_dir, buf.vegetation_type,
-        buf.burnable, buf.burned_bin,
-        static_cast<int>(n_col), static_cast<int>(n_row),
-        buf.processed_cells,
+        buf.burnable, buf.burned_bin, buf.burned_list, buf.burned_count,
+        static_cast<int>(n_col), static_cast<int>(n_row), static_cast<int>(pitch),
+        buf.processed_cells, buf.step_ends, buf.n_steps,
         buf.d_params,
         distance, upper_limit, elevation_mean, elevation_sd,
     };
@@ -437,10 +541,13 @@ Fire simulate_fire(
     cudaEventCreate(&stop);
     cudaEventRecord(start);
 
-    launch_kernel(buf, args, threads_per_block, num_blocks);
-
-    cudaEventRecord(stop);
-    cudaEventSynchronize(stop);
+    {
+        // Every spread step runs inside the persistent kernel, so the whole loop is one span
+        TRACE_SPAN("spread_kernel", "simulation");
+        launch_kernel(buf, args, params, options, threads_per_block, num_blocks);
+        cudaEventRecord(stop);
+        cudaEventSynchronize(stop);
+    }
     float milliseconds = 0;
     cudaEventElapsedTime(&milliseconds, start, stop);
 
@@ -449,11 +556,12 @@ Fire simulate_fire(
 
     float seconds = milliseconds / 1000.0f;
 
-    Fire result = copy_results_from_device(buf, n_row, n_col);
-
-    free_device_memory(buf);
-
-    result.time_taken = seconds;
+    {
+        TRACE_SPAN("copy_results", "results");
+        copy_results_from_device(buf, n_row, n_col, options, fire);
+        free_device_memory(buf);
+        device_usage.set(0);
+    }
 
-    return result;
+    fire.time_taken = seconds;
 }
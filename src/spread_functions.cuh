@@ -18,8 +18,35 @@ struct SimulationParams {
   float aspect_pred;
 };
 
-// TODO: Ver de pasar landscape como const std::vector<Cell>&
+// What a GPU simulation computes besides the burned cells. Each combination (and each group of
+// coefficients that are zero, see spread_traits.hpp) runs its own instantiation of the kernel.
+struct SpreadOptions {
+  // Fill `burned_ids_steps` with the end of every step, not only of the whole fire
+  bool record_steps = false;
+  // Count `processed_cells`, left at 0 otherwise
+  bool count_metrics = true;
+  // Pad the device layers with a non-burnable border, so neighbors need no bounds checks
+  bool halo = true;
+};
+
 Fire simulate_fire(
-  LandscapeSoA landscape, size_t n_row, size_t n_col, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+  const LandscapeSoA& landscape, size_t n_row, size_t n_col, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
   SimulationParams params, float distance, float elevation_mean, float elevation_sd, int n_replicate, float upper_limit
 );
+
+// Same as above, reading the layers through a non-owning view (n_row and n_col are taken from it)
+Fire simulate_fire(
+  const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+  SimulationParams params, float distance, float elevation_mean, float elevation_sd, int n_replicate, float upper_limit
+);
+
+// Same as above, writing the result into `fire` and reusing its storage, so that simulating many
+// replicates into the same Fire doesn't allocate once it has grown to the largest fire
+void simulate_fire(
+  const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+  SimulationParams params, float distance, float elevation_mean, float elevation_sd, int n_replicate, float upper_limit,
+  Fire& fire, SpreadOptions options = {}
+);
+
+// Device memory taken by one simulation on a landscape of the given size
+size_t device_memory_bytes(size_t width, size_t height, const SpreadOptions& options = {});
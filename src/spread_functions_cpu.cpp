@@ -0,0 +1,578 @@
+#include "spread_functions_cpu.hpp"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "spread_traits.hpp"
+#include "trace.hpp"
+
+constexpr float PIf = 3.1415927f;
+
+const int MOVES[N_NEIGHBORS][2] = {
+  { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, -1 }, { 0, 1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }
+};
+
+const float ANGLES[N_NEIGHBORS] = {
+  PIf * 3 / 4, PIf, PIf * 5 / 4, PIf / 2, PIf * 3 / 2, PIf / 4, 0, PIf * 7 / 4
+};
+
+float spread_probability_cpu(
+    float burning_elevation, float burning_wind_direction, float elevation, float vegetation_type,
+    float fwi, float aspect, int n, const SimulationParams& params, float distance,
+    float elevation_mean, float elevation_sd, float upper_limit
+) {
+  float slope_term = std::sin(std::atan((elevation - burning_elevation) / distance));
+  float wind_term = std::cos(ANGLES[n] - burning_wind_direction);
+  float elev_term = (elevation - elevation_mean) / elevation_sd;
+  return spread_probability_from_terms(
+      slope_term, wind_term, elev_term, vegetation_type, fwi, aspect, params, upper_limit
+  );
+}
+
+float spread_probability_from_terms(
+    float slope_term, float wind_term, float elev_term, float vegetation_type, float fwi,
+    float aspect, const SimulationParams& params, float upper_limit
+) {
+  float linpred = linear_predictor<ALL_TERMS>(
+      params, vegetation_type, fwi, aspect, wind_term, elev_term, slope_term
+  );
+  return upper_limit / (1.0f + std::exp(-linpred));
+}
+
+float spread_probability_cpu(
+    const LandscapeView& landscape, size_t burning, size_t neighbor, int n,
+    const SimulationParams& params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit
+) {
+  burning = landscape.layer_index(burning);
+  neighbor = landscape.layer_index(neighbor);
+  return spread_probability_cpu(
+      landscape.elevation[burning], landscape.wind_dir[burning], landscape.elevation[neighbor],
+      landscape.vegetation_type[neighbor], landscape.fwi[neighbor], landscape.aspect[neighbor], n,
+      params, distance, elevation_mean, elevation_sd, upper_limit
+  );
+}
+
+float spread_probability_cpu(
+    const LandscapeView& landscape, const DerivedView& derived, size_t burning, size_t neighbor,
+    int n, const SimulationParams& params, float upper_limit
+) {
+  size_t edge = burning * N_NEIGHBORS + n;
+  // The derived layers are indexed by the linear index, the layers of a window are strided
+  size_t layer = landscape.layer_index(neighbor);
+  return spread_probability_from_terms(
+      derived.slope_term[edge], derived.wind_term[edge], derived.elevation_term[neighbor],
+      landscape.vegetation_type[layer], landscape.fwi[layer], landscape.aspect[layer], params,
+      upper_limit
+  );
+}
+
+CpuFireState start_fire_cpu(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    uint64_t seed
+) {
+  CpuFireState state = { seed, { EdgeStream::INDEPENDENT, 0, 1 }, {}, {}, {}, 0, 0 };
+  restart_fire_cpu(state, landscape, ignition_cells, seed);
+  return state;
+}
+
+void restart_fire_cpu(
+    CpuFireState& state, const LandscapeView& landscape,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, uint64_t seed
+) {
+  size_t n_cells = landscape.width * landscape.height;
+  if (state.burned.size() == n_cells) {
+    for (size_t idx : state.burned_ids) {
+      state.burned[idx] = 0;
+    }
+  } else {
+    state.burned.assign(n_cells, 0);
+  }
+  state.seed = seed;
+  state.burned_ids.clear();
+  state.burned_ids_steps.clear();
+  state.frontier_start = 0;
+  state.processed_cells = 0;
+
+  for (auto [x, y] : ignition_cells) {
+    size_t idx = utils::INDEX(x, y, landscape.width);
+    if (!state.burned[idx]) {
+      state.burned[idx] = 1;
+      state.burned_ids.push_back(idx);
+    }
+  }
+  state.burned_ids_steps.push_back(state.burned_ids.size());
+}
+
+bool advance_fire_step_cpu(
+    CpuFireState& state, const LandscapeView& landscape, const SimulationParams& params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit
+) {
+  size_t start = state.frontier_start;
+  size_t end = state.burned_ids.size();
+  if (start == end) {
+    return false;
+  }
+  TRACE_SPAN("spread_step", "simulation", "step", state.burned_ids_steps.size() - 1);
+
+  int width = landscape.width;
+  int height = landscape.height;
+
+  for (size_t b = start; b < end; b++) {
+    size_t burning = state.burned_ids[b];
+    int i = burning % width;
+    int j = burning / width;
+
+    for (int n = 0; n < N_NEIGHBORS; n++) {
+      int ni = i + MOVES[n][0];
+      int nj = j + MOVES[n][1];
+      if (ni < 0 || nj < 0 || ni >= width || nj >= height) {
+        continue;
+      }
+      state.processed_cells++;
+
+      size_t neighbor = utils::INDEX(ni, nj, width);
+      if (state.burned[neighbor] || !landscape.burnable[nj * landscape.row_stride() + ni]) {
+        continue;
+      }
+
+      float prob = spread_probability_cpu(
+          landscape, burning, neighbor, n, params, distance, elevation_mean, elevation_sd,
+          upper_limit
+      );
+      if (edge_draw(state.seed, state.stream, burning, n) < prob) {
+        state.burned[neighbor] = 1;
+        state.burned_ids.push_back(neighbor);
+      }
+    }
+  }
+
+  state.frontier_start = end;
+  if (state.burned_ids.size() == end) {
+    return false;
+  }
+  state.burned_ids_steps.push_back(state.burned_ids.size());
+  return true;
+}
+
+namespace {
+
+// Spread step reading only the layers of the groups in `Terms`, see spread_traits.hpp
+template <unsigned Terms>
+bool advance_fire_step_terms(
+    CpuFireState& state, const LandscapeView& landscape, const DerivedView& derived,
+    const SimulationParams& params, float upper_limit
+) {
+  size_t start = state.frontier_start;
+  size_t end = state.burned_ids.size();
+  if (start == end) {
+    return false;
+  }
+  TRACE_SPAN("spread_step", "simulation", "step", state.burned_ids_steps.size() - 1);
+
+  int width = landscape.width;
+  int height = landscape.height;
+
+  for (size_t b = start; b < end; b++) {
+    size_t burning = state.burned_ids[b];
+    int i = burning % width;
+    int j = burning / width;
+
+    // Neighbors inside the landscape, the only bounds check left in the loop
+    state.processed_cells += (1 + (i > 0) + (i + 1 < width)) * (1 + (j > 0) + (j + 1 < height)) - 1;
+
+    for (unsigned mask = derived.burnable_neighbors[burning]; mask; mask &= mask - 1) {
+      int n = __builtin_ctz(mask);
+      size_t neighbor = burning + MOVES[n][0] + MOVES[n][1] * width;
+      if (state.burned[neighbor]) {
+        continue;
+      }
+
+      size_t edge = burning * N_NEIGHBORS + n;
+      bool vegetation = Terms & VEGETATION_TERMS;
+      bool covariates = Terms & COVARIATE_TERMS;
+      bool topography = Terms & TOPOGRAPHY_TERMS;
+      float linpred = linear_predictor<Terms>(
+          params, vegetation ? landscape.vegetation_type[neighbor] : 0.0f,
+          covariates ? landscape.fwi[neighbor] : 0.0f,
+          covariates ? landscape.aspect[neighbor] : 0.0f,
+          topography ? derived.wind_term[edge] : 0.0f,
+          topography ? derived.elevation_term[neighbor] : 0.0f,
+          topography ? derived.slope_term[edge] : 0.0f
+      );
+      float prob = upper_limit / (1.0f + std::exp(-linpred));
+      if (edge_draw(state.seed, state.stream, burning, n) < prob) {
+        state.burned[neighbor] = 1;
+        state.burned_ids.push_back(neighbor);
+      }
+    }
+  }
+
+  state.frontier_start = end;
+  if (state.burned_ids.size() == end) {
+    return false;
+  }
+  state.burned_ids_steps.push_back(state.burned_ids.size());
+  return true;
+}
+
+using StepFunction = bool (*)(
+    CpuFireState&, const LandscapeView&, const DerivedView&, const SimulationParams&, float
+);
+
+template <unsigned... Terms>
+constexpr std::array<StepFunction, sizeof...(Terms)> step_functions(
+    std::integer_sequence<unsigned, Terms...>
+) {
+  return { &advance_fire_step_terms<Terms>... };
+}
+
+// One instantiation per combination of groups, indexed by `active_terms`
+constexpr std::array<StepFunction, N_TERM_COMBINATIONS> STEP_FUNCTIONS =
+    step_functions(std::make_integer_sequence<unsigned, N_TERM_COMBINATIONS>());
+
+} // namespace
+
+bool advance_fire_step_cpu(
+    CpuFireState& state, const LandscapeView& landscape, const DerivedView& derived,
+    const SimulationParams& params, float upper_limit
+) {
+  require_contiguous(landscape, "The step with derived layers");
+  return STEP_FUNCTIONS[active_terms(params)](state, landscape, derived, params, upper_limit);
+}
+
+namespace {
+
+// Table of `value(probability)` for every edge, 0 for the edges that are never read
+template <typename T, typename Value>
+std::vector<T> edge_table(
+    const LandscapeView& landscape, const DerivedView& derived, const SimulationParams& params,
+    float upper_limit, Value value
+) {
+  size_t n_cells = landscape.width * landscape.height;
+  int width = landscape.width;
+  std::vector<T> table(n_cells * N_NEIGHBORS, T(0));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t cell = 0; cell < n_cells; cell++) {
+    for (unsigned mask = derived.burnable_neighbors[cell]; mask; mask &= mask - 1) {
+      int n = __builtin_ctz(mask);
+      size_t neighbor = cell + MOVES[n][0] + MOVES[n][1] * width;
+      table[cell * N_NEIGHBORS + n] =
+          value(spread_probability_cpu(landscape, derived, cell, neighbor, n, params, upper_limit));
+    }
+  }
+  return table;
+}
+
+} // namespace
+
+std::vector<float> edge_probabilities(
+    const LandscapeView& landscape, const DerivedView& derived, const SimulationParams& params,
+    float upper_limit
+) {
+  require_contiguous(landscape, "The edge probability table");
+  TRACE_SPAN("edge_probabilities", "setup");
+  return edge_table<float>(landscape, derived, params, upper_limit, [](float p) { return p; });
+}
+
+std::vector<uint32_t> edge_thresholds(
+    const LandscapeView& landscape, const DerivedView& derived, const SimulationParams& params,
+    float upper_limit
+) {
+  require_contiguous(landscape, "The edge threshold table");
+  TRACE_SPAN("edge_thresholds", "setup");
+  return edge_table<uint32_t>(landscape, derived, params, upper_limit, edge_threshold);
+}
+
+bool advance_fire_step_cpu(
+    CpuFireState& state, const DerivedView& derived, const float* edge_probability
+) {
+  size_t start = state.frontier_start;
+  size_t end = state.burned_ids.size();
+  if (start == end) {
+    return false;
+  }
+  TRACE_SPAN("spread_step", "simulation", "step", state.burned_ids_steps.size() - 1);
+
+  int width = derived.width;
+  int height = derived.height;
+
+  for (size_t b = start; b < end; b++) {
+    size_t burning = state.burned_ids[b];
+    int i = burning % width;
+    int j = burning / width;
+    state.processed_cells += (1 + (i > 0) + (i + 1 < width)) * (1 + (j > 0) + (j + 1 < height)) - 1;
+
+    for (unsigned mask = derived.burnable_neighbors[burning]; mask; mask &= mask - 1) {
+      int n = __builtin_ctz(mask);
+      size_t neighbor = burning + MOVES[n][0] + MOVES[n][1] * width;
+      if (state.burned[neighbor]) {
+        continue;
+      }
+
+      float prob = edge_probability[burning * N_NEIGHBORS + n];
+      if (edge_draw(state.seed, state.stream, burning, n) < prob) {
+        state.burned[neighbor] = 1;
+        state.burned_ids.push_back(neighbor);
+      }
+    }
+  }
+
+  state.frontier_start = end;
+  if (state.burned_ids.size() == end) {
+    return false;
+  }
+  state.burned_ids_steps.push_back(state.burned_ids.size());
+  return true;
+}
+
+namespace {
+
+/* Masks of the edges of a cell that spread: bit n is set if the draw of the edge in direction n
+ * (flipped if antithetic) is below threshold[n]. The lanes are the 8 edges, hashed together.
+ */
+struct ScalarLanes {
+  static unsigned spread_mask(
+      uint64_t seed, size_t cell, const uint32_t* threshold, bool antithetic
+  ) {
+    unsigned mask = 0;
+    for (int n = 0; n < N_NEIGHBORS; n++) {
+      uint32_t draw = edge_bits(seed, cell, n) >> 40;
+      draw = antithetic ? EDGE_DRAW_ONE - draw : draw;
+      mask |= unsigned(draw < threshold[n]) << n;
+    }
+    return mask;
+  }
+};
+
+#if defined(__x86_64__)
+
+// The build doesn't pass -march, so these are compiled for their own targets and picked at run time
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx512f,avx512dq")))
+
+struct Avx2Lanes {
+  // Low 64 bits of a * b per lane, from 32-bit products
+  AVX2_TARGET static __m256i multiply(__m256i a, uint64_t b) {
+    __m256i b_low = _mm256_set1_epi64x(b & 0xffffffff);
+    __m256i b_high = _mm256_set1_epi64x(b >> 32);
+    __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b_low), _mm256_mul_epu32(a, b_high)
+    );
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b_low), _mm256_slli_epi64(cross, 32));
+  }
+
+  // edge_bits(...) >> 40 of 4 keys
+  AVX2_TARGET static __m256i draws(__m256i z) {
+    z = multiply(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), 0xbf58476d1ce4e5b9ULL);
+    z = multiply(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), 0x94d049bb133111ebULL);
+    return _mm256_srli_epi64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 31)), 40);
+  }
+
+  AVX2_TARGET static unsigned spread_mask(
+      uint64_t seed, size_t cell, const uint32_t* threshold, bool antithetic
+  ) {
+    __m256i key = _mm256_set1_epi64x(seed * 0x9e3779b97f4a7c15ULL + uint64_t(cell) * N_NEIGHBORS);
+    __m256i low = draws(_mm256_add_epi64(key, _mm256_setr_epi64x(0, 1, 2, 3)));
+    __m256i high = draws(_mm256_add_epi64(key, _mm256_setr_epi64x(4, 5, 6, 7)));
+    // The draws fit in 32 bits, gather the low halves of the 8 lanes
+    __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    __m256i draw = _mm256_blend_epi32(
+        _mm256_permutevar8x32_epi32(low, even), _mm256_permutevar8x32_epi32(high, even), 0xf0
+    );
+    if (antithetic) {
+      draw = _mm256_sub_epi32(_mm256_set1_epi32(EDGE_DRAW_ONE), draw);
+    }
+    // Signed compare, the draws are at most 2^24 and the thresholds are clamped below 2^31
+    __m256i limit = _mm256_min_epu32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(threshold)),
+        _mm256_set1_epi32(0x7fffffff)
+    );
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, draw)));
+  }
+};
+
+struct Avx512Lanes {
+  // The zero-masked forms, the others leave GCC 12 warning about their undefined source
+  AVX512_TARGET static __m512i shift_right(__m512i z, unsigned bits) {
+    return _mm512_maskz_srli_epi64(0xff, z, bits);
+  }
+
+  AVX512_TARGET static unsigned spread_mask(
+      uint64_t seed, size_t cell, const uint32_t* threshold, bool antithetic
+  ) {
+    __m512i z = _mm512_add_epi64(
+        _mm512_set1_epi64(seed * 0x9e3779b97f4a7c15ULL + uint64_t(cell) * N_NEIGHBORS),
+        _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7)
+    );
+    z = _mm512_mullo_epi64(
+        _mm512_xor_si512(z, shift_right(z, 30)), _mm512_set1_epi64(0xbf58476d1ce4e5b9ULL)
+    );
+    z = _mm512_mullo_epi64(
+        _mm512_xor_si512(z, shift_right(z, 27)), _mm512_set1_epi64(0x94d049bb133111ebULL)
+    );
+    __m512i draw = shift_right(_mm512_xor_si512(z, shift_right(z, 31)), 40);
+    if (antithetic) {
+      draw = _mm512_sub_epi64(_mm512_set1_epi64(EDGE_DRAW_ONE), draw);
+    }
+    __m512i limit = _mm512_maskz_cvtepu32_epi64(
+        0xff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(threshold))
+    );
+    return _mm512_cmplt_epi64_mask(draw, limit);
+  }
+};
+
+#endif
+
+template <typename Lanes>
+__attribute__((always_inline)) inline bool advance_fire_step_lanes(
+    CpuFireState& state, const DerivedView& derived, const uint32_t* edge_threshold
+) {
+  size_t start = state.frontier_start;
+  size_t end = state.burned_ids.size();
+  if (start == end) {
+    return false;
+  }
+  TRACE_SPAN("spread_step", "simulation", "step", state.burned_ids_steps.size() - 1);
+
+  int width = derived.width;
+  int height = derived.height;
+  bool antithetic = state.stream.kind == EdgeStream::ANTITHETIC && state.stream.index != 0;
+
+  for (size_t b = start; b < end; b++) {
+    size_t burning = state.burned_ids[b];
+    int i = burning % width;
+    int j = burning / width;
+    state.processed_cells += (1 + (i > 0) + (i + 1 < width)) * (1 + (j > 0) + (j + 1 < height)) - 1;
+
+    // The thresholds of the edges out of the landscape or into unburnable cells are 0
+    unsigned spread = Lanes::spread_mask(
+        state.seed, burning, edge_threshold + burning * N_NEIGHBORS, antithetic
+    );
+    for (; spread; spread &= spread - 1) {
+      int n = __builtin_ctz(spread);
+      size_t neighbor = burning + MOVES[n][0] + MOVES[n][1] * width;
+      if (!state.burned[neighbor]) {
+        state.burned[neighbor] = 1;
+        state.burned_ids.push_back(neighbor);
+      }
+    }
+  }
+
+  state.frontier_start = end;
+  if (state.burned_ids.size() == end) {
+    return false;
+  }
+  state.burned_ids_steps.push_back(state.burned_ids.size());
+  return true;
+}
+
+bool advance_fire_step_scalar(
+    CpuFireState& state, const DerivedView& derived, const uint32_t* edge_threshold
+) {
+  return advance_fire_step_lanes<ScalarLanes>(state, derived, edge_threshold);
+}
+
+#if defined(__x86_64__)
+
+AVX2_TARGET bool advance_fire_step_avx2(
+    CpuFireState& state, const DerivedView& derived, const uint32_t* edge_threshold
+) {
+  return advance_fire_step_lanes<Avx2Lanes>(state, derived, edge_threshold);
+}
+
+AVX512_TARGET bool advance_fire_step_avx512(
+    CpuFireState& state, const DerivedView& derived, const uint32_t* edge_threshold
+) {
+  return advance_fire_step_lanes<Avx512Lanes>(state, derived, edge_threshold);
+}
+
+#endif
+
+// The widest version the CPU supports, up to FIRE_SPREAD_SIMD
+ThresholdStep threshold_step_function() {
+  const char* simd = std::getenv("FIRE_SPREAD_SIMD");
+  std::string limit = simd ? simd : "avx512";
+  if (limit != "scalar" && limit != "avx2" && limit != "avx512") {
+    throw std::runtime_error("Unknown FIRE_SPREAD_SIMD " + limit + " (expected scalar, avx2 or avx512)");
+  }
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (limit == "avx512" && __builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512dq")) {
+    return &advance_fire_step_avx512;
+  }
+  if (limit != "scalar" && __builtin_cpu_supports("avx2")) {
+    return &advance_fire_step_avx2;
+  }
+#endif
+  return &advance_fire_step_scalar;
+}
+
+} // namespace
+
+ThresholdStep threshold_step(EdgeStream stream) {
+  if (stream == EdgeStream::STRATIFIED) {
+    throw std::runtime_error("Stratified draws can't be compared with edge thresholds");
+  }
+  return threshold_step_function();
+}
+
+void fire_from_state(const CpuFireState& state, size_t width, size_t height, Fire& fire) {
+  fire.reset(width, height);
+  for (size_t idx : state.burned_ids) {
+    fire.add_burned(idx);
+  }
+  fire.burned_ids_steps = state.burned_ids_steps;
+  fire.processed_cells = state.processed_cells;
+}
+
+Fire fire_from_state(const CpuFireState& state, size_t width, size_t height) {
+  Fire fire = empty_fire(width, height);
+  fire_from_state(state, width, height, fire);
+  return fire;
+}
+
+Fire simulate_fire_cpu(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    int n_replicate, float upper_limit
+) {
+  auto start = std::chrono::steady_clock::now();
+
+  CpuFireState state = start_fire_cpu(landscape, ignition_cells, replicate_seed(n_replicate));
+  while (advance_fire_step_cpu(
+      state, landscape, params, distance, elevation_mean, elevation_sd, upper_limit
+  )) {
+  }
+
+  Fire fire = fire_from_state(state, landscape.width, landscape.height);
+  fire.time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return fire;
+}
+
+Fire simulate_fire_cpu(
+    const LandscapeView& landscape, const DerivedView& derived,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    int n_replicate, float upper_limit
+) {
+  auto start = std::chrono::steady_clock::now();
+
+  CpuFireState state = start_fire_cpu(landscape, ignition_cells, replicate_seed(n_replicate));
+  while (advance_fire_step_cpu(state, landscape, derived, params, upper_limit)) {
+  }
+
+  Fire fire = fire_from_state(state, landscape.width, landscape.height);
+  fire.time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return fire;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "derived_layers.hpp"
+#include "fires.hpp"
+#include "landscape.hpp"
+#include "spread_functions.cuh"
+
+/* Host implementation of the spread model.
+ *
+ * Unlike the CUDA kernel (one curand stream per cell), every Bernoulli trial here uses a
+ * counter-based draw that only depends on (seed, burning cell, direction). Since a cell is in the
+ * frontier exactly once, each edge is tried at most once per replicate and the burned cells of
+ * every step don't depend on the order in which the frontier is traversed, on how many threads
+ * process it, or on how the landscape is partitioned.
+ */
+
+constexpr int N_NEIGHBORS = 8;
+
+// Same directions and angles as the CUDA kernel
+extern const int MOVES[N_NEIGHBORS][2];
+extern const float ANGLES[N_NEIGHBORS];
+
+// Seed used for replicate `n_replicate`, the same convention as `simulate_fire`
+inline uint64_t replicate_seed(int n_replicate) {
+  return 123 + n_replicate;
+}
+
+// 64 random bits for the edge leaving `cell` in direction `n` (splitmix64 finalizer over the key)
+inline uint64_t edge_bits(uint64_t seed, size_t cell, int n) {
+  uint64_t z = seed * 0x9e3779b97f4a7c15ULL + (uint64_t(cell) * N_NEIGHBORS + n);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1) for the edge leaving `cell` in direction `n`
+inline float edge_uniform(uint64_t seed, size_t cell, int n) {
+  return (edge_bits(seed, cell, n) >> 40) * (1.0f / 16777216.0f);
+}
+
+/* How the draws of a replicate are related to those of the other replicates of its block (see
+ * burn_estimator.hpp). Every draw is uniform on its own, so each replicate is still a valid fire:
+ * - INDEPENDENT: u = edge_uniform(seed, cell, n), each block has a single replicate
+ * - ANTITHETIC: blocks of two replicates, the second one uses 1 - u
+ * - STRATIFIED: Latin hypercube over a block of `size` replicates (a power of two). Every edge
+ *   splits [0, 1) in `size` strata and gives a different one to each replicate of the block, through
+ *   a random affine permutation of the replicate index that changes from edge to edge.
+ */
+enum class EdgeStream : uint8_t { INDEPENDENT, ANTITHETIC, STRATIFIED };
+
+struct EdgeStreamPosition {
+  EdgeStream kind;
+  uint32_t index;
+  uint32_t size;
+};
+
+inline float edge_draw(uint64_t seed, const EdgeStreamPosition& stream, size_t cell, int n) {
+  switch (stream.kind) {
+  case EdgeStream::ANTITHETIC: {
+    float u = edge_uniform(seed, cell, n);
+    return stream.index == 0 ? u : 1.0f - u;
+  }
+  case EdgeStream::STRATIFIED: {
+    uint64_t bits = edge_bits(seed, cell, n);
+    uint32_t stratum = ((uint32_t(bits >> 32) | 1) * stream.index + uint32_t(bits)) & (stream.size - 1);
+    float jitter = edge_uniform(seed + 0x632be59bd9b4e019ULL * (stream.index + 1), cell, n);
+    return (stratum + jitter) / stream.size;
+  }
+  default:
+    return edge_uniform(seed, cell, n);
+  }
+}
+
+/* Integer form of the trials. edge_uniform is a 24-bit integer k over EDGE_DRAW_ONE, so
+ * edge_uniform(...) < p exactly when k < edge_threshold(p), and its antithetic 1 - edge_uniform(...)
+ * < p exactly when EDGE_DRAW_ONE - k < edge_threshold(p). Thresholds give the same fires as the
+ * probabilities without converting any draw to float. STRATIFIED draws have no such form.
+ */
+constexpr uint32_t EDGE_DRAW_ONE = uint32_t(1) << 24;
+
+inline uint32_t edge_threshold(float probability) {
+  return uint32_t(std::ceil(probability * float(EDGE_DRAW_ONE)));
+}
+
+// Probability that the fire spreads in direction `n` from a cell with the given elevation and wind
+// direction to a neighbor with the given layers. Does not check whether the neighbor is burnable.
+float spread_probability_cpu(
+    float burning_elevation, float burning_wind_direction, float elevation, float vegetation_type,
+    float fwi, float aspect, int n, const SimulationParams& params, float distance,
+    float elevation_mean, float elevation_sd, float upper_limit
+);
+
+// Same as above reading the layers of cells `burning` and `neighbor` from `landscape`
+float spread_probability_cpu(
+    const LandscapeView& landscape, size_t burning, size_t neighbor, int n,
+    const SimulationParams& params, float distance, float elevation_mean, float elevation_sd,
+    float upper_limit
+);
+
+// Same as above from the precomputed terms of the edge from `burning` to `neighbor`
+float spread_probability_cpu(
+    const LandscapeView& landscape, const DerivedView& derived, size_t burning, size_t neighbor,
+    int n, const SimulationParams& params, float upper_limit
+);
+
+// Combination of the landscape terms of an edge with the parameters, shared by the overloads above
+float spread_probability_from_terms(
+    float slope_term, float wind_term, float elev_term, float vegetation_type, float fwi,
+    float aspect, const SimulationParams& params, float upper_limit
+);
+
+// Burn state of a fire being simulated step by step
+struct CpuFireState {
+  uint64_t seed;
+  EdgeStreamPosition stream;
+  std::vector<uint8_t> burned;
+  // Linear indices of the burned cells, in the order they were burned
+  std::vector<size_t> burned_ids;
+  // Positions in burned_ids where a new step starts
+  std::vector<size_t> burned_ids_steps;
+  // Start of the current frontier in burned_ids
+  size_t frontier_start;
+  unsigned int processed_cells;
+
+  // Bytes allocated by the vectors, which only grow while the state is reused
+  size_t capacity_bytes() const {
+    return burned.capacity() * sizeof(uint8_t) + burned_ids.capacity() * sizeof(size_t) +
+           burned_ids_steps.capacity() * sizeof(size_t);
+  }
+};
+
+CpuFireState start_fire_cpu(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    uint64_t seed
+);
+
+// Same as `start_fire_cpu`, reusing the buffers of `state` (only the cells burned by the previous
+// fire are cleared). The stream of `state` is kept.
+void restart_fire_cpu(
+    CpuFireState& state, const LandscapeView& landscape,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, uint64_t seed
+);
+
+// Burns the cells reached from the current frontier. Returns false once the fire is extinguished.
+bool advance_fire_step_cpu(
+    CpuFireState& state, const LandscapeView& landscape, const SimulationParams& params,
+    float distance, float elevation_mean, float elevation_sd, float upper_limit
+);
+
+// Same as above reading the landscape terms from `derived` (computed with the same model
+// constants), which gives exactly the same fire
+bool advance_fire_step_cpu(
+    CpuFireState& state, const LandscapeView& landscape, const DerivedView& derived,
+    const SimulationParams& params, float upper_limit
+);
+
+/* Spread probability of every edge (index cell * N_NEIGHBORS + n) for fixed parameters. It doesn't
+ * depend on the fire, so it is computed once and shared by every fire with those parameters.
+ * Edges into unburnable cells or out of the landscape are 0 and never read.
+ */
+std::vector<float> edge_probabilities(
+    const LandscapeView& landscape, const DerivedView& derived, const SimulationParams& params,
+    float upper_limit
+);
+
+// Same as above reading the probabilities from a table of `edge_probabilities`, which gives
+// exactly the same fire
+bool advance_fire_step_cpu(
+    CpuFireState& state, const DerivedView& derived, const float* edge_probability
+);
+
+// `edge_threshold` of every edge of `edge_probabilities`, the table of the step below
+std::vector<uint32_t> edge_thresholds(
+    const LandscapeView& landscape, const DerivedView& derived, const SimulationParams& params,
+    float upper_limit
+);
+
+/* Same as above with a table of `edge_thresholds`, which gives exactly the same fire for INDEPENDENT
+ * and ANTITHETIC streams. The 8 draws of a burning cell are computed and compared with its
+ * thresholds at once, in AVX-512 or AVX2 registers if the CPU has them (at most the instructions
+ * named by FIRE_SPREAD_SIMD=scalar|avx2|avx512, if set), which gives a mask of the edges that spread.
+ *
+ * The version is chosen by `threshold_step` for the kind of stream of the fires it will advance.
+ * It throws for STRATIFIED streams or an unknown FIRE_SPREAD_SIMD, so call it before a parallel
+ * region: the step it returns never throws.
+ */
+using ThresholdStep = bool (*)(CpuFireState& state, const DerivedView& derived, const uint32_t* edge_threshold);
+
+ThresholdStep threshold_step(EdgeStream stream);
+
+Fire fire_from_state(const CpuFireState& state, size_t width, size_t height);
+
+// Same as above, writing into (and reusing the storage of) `fire`
+void fire_from_state(const CpuFireState& state, size_t width, size_t height, Fire& fire);
+
+// Host counterpart of `simulate_fire`, seeded with `replicate_seed(n_replicate)`
+Fire simulate_fire_cpu(
+    const LandscapeView& landscape, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    int n_replicate, float upper_limit
+);
+
+// Same as above reading the landscape terms from `derived`
+Fire simulate_fire_cpu(
+    const LandscapeView& landscape, const DerivedView& derived,
+    const std::vector<std::pair<size_t, size_t>>& ignition_cells, SimulationParams params,
+    int n_replicate, float upper_limit
+);
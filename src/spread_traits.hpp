@@ -0,0 +1,72 @@
+#pragma once
+
+#include "landscape.hpp"
+#include "spread_functions.cuh"
+
+#ifdef __CUDACC__
+#define SPREAD_HOST_DEVICE __host__ __device__
+#else
+#define SPREAD_HOST_DEVICE
+#endif
+
+/* Groups of terms of the linear predictor, used as compile-time traits of the spread loops.
+ *
+ * A group whose coefficients are all zero adds exactly 0 to the linear predictor (the layers are
+ * finite), so a loop instantiated without it gives the same probabilities while skipping its loads,
+ * its branches and its arithmetic. `active_terms` picks the groups from the actual parameters and
+ * the engines dispatch to the matching instantiation.
+ */
+enum SpreadTerms : unsigned {
+  VEGETATION_TERMS = 1, // subalpine, wet and dry
+  COVARIATE_TERMS = 2,  // fwi and aspect
+  TOPOGRAPHY_TERMS = 4, // wind, elevation and slope
+  ALL_TERMS = 7,
+};
+
+constexpr unsigned N_TERM_COMBINATIONS = ALL_TERMS + 1;
+
+inline unsigned active_terms(const SimulationParams& params) {
+  unsigned terms = 0;
+  if (params.subalpine_pred != 0 || params.wet_pred != 0 || params.dry_pred != 0) {
+    terms |= VEGETATION_TERMS;
+  }
+  if (params.fwi_pred != 0 || params.aspect_pred != 0) {
+    terms |= COVARIATE_TERMS;
+  }
+  if (params.wind_pred != 0 || params.elevation_pred != 0 || params.slope_pred != 0) {
+    terms |= TOPOGRAPHY_TERMS;
+  }
+  return terms;
+}
+
+// Linear predictor of an edge with the groups of `Terms` (the arguments of the other groups are
+// ignored). With ALL_TERMS it is the model of `spread_probability_cpu`, in the same order.
+template <unsigned Terms>
+SPREAD_HOST_DEVICE inline float linear_predictor(
+    const SimulationParams& params, float vegetation_type, float fwi, float aspect,
+    float wind_term, float elev_term, float slope_term
+) {
+  float linpred = params.independent_pred;
+
+  if (Terms & VEGETATION_TERMS) {
+    int vegetation = vegetation_type;
+    if (vegetation == SUBALPINE) {
+      linpred += params.subalpine_pred;
+    } else if (vegetation == WET) {
+      linpred += params.wet_pred;
+    } else if (vegetation == DRY) {
+      linpred += params.dry_pred;
+    }
+  }
+
+  if (Terms & COVARIATE_TERMS) {
+    linpred += params.fwi_pred * fwi;
+    linpred += params.aspect_pred * aspect;
+  }
+
+  if (Terms & TOPOGRAPHY_TERMS) {
+    linpred += wind_term * params.wind_pred + elev_term * params.elevation_pred +
+               slope_term * params.slope_pred;
+  }
+  return linpred;
+}
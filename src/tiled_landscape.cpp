@@ -0,0 +1,441 @@
+#include "tiled_landscape.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "csv.hpp"
+#include "landscape.hpp"
+#include "spread_functions_cpu.hpp"
+#include "trace.hpp"
+
+namespace {
+
+constexpr uint64_t TILES_MAGIC = 0x46495245544c4532; // "FIRETLE2"
+constexpr size_t HEADER_BYTES = 4096;
+
+// Byte offsets of each layer inside a tile of `cells` cells
+struct TileLayout {
+  size_t elevation, fwi, aspect, vegetation_type, wind_dir, burnable, burn_tag, total;
+};
+
+TileLayout tile_layout(size_t tile_size) {
+  size_t cells = tile_size * tile_size;
+  TileLayout layout;
+  layout.elevation = 0;
+  layout.fwi = cells * sizeof(float);
+  layout.aspect = 2 * cells * sizeof(float);
+  layout.vegetation_type = 3 * cells * sizeof(float);
+  layout.wind_dir = 4 * cells * sizeof(float);
+  layout.burnable = 5 * cells * sizeof(float);
+  layout.burn_tag = (layout.burnable + cells + 3) & ~size_t(3);
+  layout.total = layout.burn_tag + cells * sizeof(uint32_t);
+  return layout;
+}
+
+template <typename T> void put(std::vector<char>& data, size_t offset, size_t i, T value) {
+  std::memcpy(&data[offset + i * sizeof(T)], &value, sizeof(T));
+}
+
+template <typename T> T get(const std::vector<char>& data, size_t offset, size_t i) {
+  T value;
+  std::memcpy(&value, &data[offset + i * sizeof(T)], sizeof(T));
+  return value;
+}
+
+void pwrite_all(int fd, const void* data, size_t n, size_t offset) {
+  const char* ptr = static_cast<const char*>(data);
+  while (n > 0) {
+    ssize_t written = pwrite(fd, ptr, n, offset);
+    if (written <= 0) {
+      throw std::runtime_error("Can't write tile file");
+    }
+    ptr += written;
+    offset += written;
+    n -= written;
+  }
+}
+
+void pread_all(int fd, void* data, size_t n, size_t offset) {
+  char* ptr = static_cast<char*>(data);
+  while (n > 0) {
+    ssize_t got = pread(fd, ptr, n, offset);
+    if (got <= 0) {
+      throw std::runtime_error("Can't read tile file");
+    }
+    ptr += got;
+    offset += got;
+    n -= got;
+  }
+}
+
+// The landscape hash of a tiled landscape, taken over the bytes of its files: `landscape_hash`
+// would need every layer in memory at once
+uint64_t landscape_files_hash(const std::string& metadata_filename, const std::string& data_filename) {
+  TRACE_SPAN("landscape_files_hash", "io");
+  uint64_t hash = fnv1a(nullptr, 0);
+  std::vector<char> buffer(1 << 16);
+  for (const std::string& filename : { metadata_filename, data_filename }) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("Can't open " + filename);
+    }
+    while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+      hash = fnv1a(buffer.data(), file.gcount(), hash);
+    }
+  }
+  return hash;
+}
+
+} // namespace
+
+void convert_landscape_to_tiles(
+    std::string metadata_filename, std::string data_filename, std::string tiles_filename,
+    size_t tile_size
+) {
+  TRACE_SPAN("convert_landscape_to_tiles", "io");
+
+  std::ifstream metadata_file(metadata_filename);
+  if (!metadata_file.is_open()) {
+    throw std::runtime_error("Can't open metadata file");
+  }
+  CSVIterator metadata_csv(metadata_file);
+  ++metadata_csv;
+  if (metadata_csv == CSVIterator() || (*metadata_csv).size() < 2) {
+    throw std::runtime_error("Invalid metadata file");
+  }
+  size_t width = atoi((*metadata_csv)[0].data());
+  size_t height = atoi((*metadata_csv)[1].data());
+  metadata_file.close();
+
+  TileCache::Header header = {
+    TILES_MAGIC, width, height, tile_size, (width + tile_size - 1) / tile_size,
+    (height + tile_size - 1) / tile_size, 0, landscape_files_hash(metadata_filename, data_filename)
+  };
+  TileLayout layout = tile_layout(tile_size);
+
+  int fd = open(tiles_filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Can't create tile file");
+  }
+
+  std::ifstream landscape_file(data_filename);
+  if (!landscape_file.is_open()) {
+    close(fd);
+    throw std::runtime_error("Can't open landscape file");
+  }
+  CSVIterator loop_csv(landscape_file);
+  ++loop_csv;
+
+  try {
+    std::vector<char> header_block(HEADER_BYTES, 0);
+    std::memcpy(header_block.data(), &header, sizeof(header));
+    pwrite_all(fd, header_block.data(), HEADER_BYTES, 0);
+
+    // One row of tiles at a time
+    std::vector<std::vector<char>> tile_row(header.tiles_x);
+    for (size_t ty = 0; ty < header.tiles_y; ty++) {
+      for (auto& tile : tile_row) {
+        tile.assign(layout.total, 0);
+      }
+      size_t last_row = std::min((ty + 1) * tile_size, height);
+      for (size_t j = ty * tile_size; j < last_row; j++) {
+        for (size_t i = 0; i < width; i++, ++loop_csv) {
+          if (loop_csv == CSVIterator() || (*loop_csv).size() < 8) {
+            throw std::runtime_error("Invalid landscape file");
+          }
+          std::vector<char>& tile = tile_row[i / tile_size];
+          size_t c = (j % tile_size) * tile_size + i % tile_size;
+          float vegetation_type = MATORRAL;
+          if (atoi((*loop_csv)[0].data()) == 1) {
+            vegetation_type = SUBALPINE;
+          } else if (atoi((*loop_csv)[1].data()) == 1) {
+            vegetation_type = WET;
+          } else if (atoi((*loop_csv)[2].data()) == 1) {
+            vegetation_type = DRY;
+          }
+          put<float>(tile, layout.vegetation_type, c, vegetation_type);
+          put<float>(tile, layout.fwi, c, atof((*loop_csv)[3].data()));
+          put<float>(tile, layout.aspect, c, atof((*loop_csv)[4].data()));
+          put<float>(tile, layout.wind_dir, c, atof((*loop_csv)[5].data()));
+          put<float>(tile, layout.elevation, c, atof((*loop_csv)[6].data()));
+          put<uint8_t>(tile, layout.burnable, c, atoi((*loop_csv)[7].data()));
+        }
+      }
+      for (size_t tx = 0; tx < header.tiles_x; tx++) {
+        size_t id = ty * header.tiles_x + tx;
+        pwrite_all(fd, tile_row[tx].data(), layout.total, HEADER_BYTES + id * layout.total);
+      }
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+
+  close(fd);
+}
+
+void update_landscape_tiles(
+    std::string metadata_filename, std::string data_filename, std::string tiles_filename,
+    size_t tile_size
+) {
+  TileCache::Header header = {};
+  int fd = open(tiles_filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    try {
+      pread_all(fd, &header, sizeof(header), 0);
+    } catch (std::runtime_error&) {
+      header.magic = 0; // truncated, rebuilt below
+    }
+    close(fd);
+  }
+  if (header.magic == TILES_MAGIC && header.tile_size == tile_size &&
+      header.source_hash == landscape_files_hash(metadata_filename, data_filename)) {
+    return;
+  }
+  convert_landscape_to_tiles(metadata_filename, data_filename, tiles_filename, tile_size);
+}
+
+TileCache::TileCache(std::string tiles_filename, size_t ram_budget) {
+  fd = open(tiles_filename.c_str(), O_RDWR);
+  if (fd < 0) {
+    throw std::runtime_error("Can't open tile file");
+  }
+  try {
+    pread_all(fd, &header, sizeof(header), 0);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  if (header.magic != TILES_MAGIC) {
+    close(fd);
+    throw std::runtime_error("Invalid tile file");
+  }
+  tile_bytes = tile_layout(header.tile_size).total;
+  // A cell and its neighbours span at most four tiles, which must fit at the same time
+  max_tiles = ram_budget / tile_bytes;
+  if (max_tiles < 4) {
+    close(fd);
+    throw std::runtime_error(
+        "RAM budget too small for the tile file: at least " + std::to_string(4 * tile_bytes) +
+        " bytes (four tiles) are needed"
+    );
+  }
+}
+
+TileCache::~TileCache() {
+  try {
+    flush();
+  } catch (std::runtime_error&) {
+    // can't report from a destructor, the burn state is only needed while simulating
+  }
+  close(fd);
+}
+
+void TileCache::write_header() {
+  pwrite_all(fd, &header, sizeof(header), 0);
+}
+
+void TileCache::write_back(Tile& tile) {
+  TileLayout layout = tile_layout(header.tile_size);
+  pwrite_all(
+      fd, tile.data.data() + layout.burn_tag, tile_bytes - layout.burn_tag,
+      HEADER_BYTES + tile.id * tile_bytes + layout.burn_tag
+  );
+  tile.dirty = false;
+}
+
+void TileCache::flush() {
+  for (auto& [id, tile] : resident) {
+    if (tile.dirty) {
+      write_back(tile);
+    }
+  }
+}
+
+void TileCache::evict_tile() {
+  size_t id = lru.back();
+  Tile& tile = resident.at(id);
+  if (tile.dirty) {
+    write_back(tile);
+  }
+  if (last_tile == &tile) {
+    last_tile = nullptr;
+  }
+  lru.pop_back();
+  resident.erase(id);
+  tile_evictions++;
+}
+
+TileCache::Tile& TileCache::load_tile(size_t id) {
+  TRACE_SPAN("load_tile", "io", "tile", id);
+  while (resident.size() >= max_tiles) {
+    evict_tile();
+  }
+  Tile& tile = resident[id];
+  tile.id = id;
+  tile.data.resize(tile_bytes);
+  tile.dirty = false;
+  pread_all(fd, tile.data.data(), tile_bytes, HEADER_BYTES + id * tile_bytes);
+  lru.push_front(id);
+  tile.lru_position = lru.begin();
+  tile_loads++;
+  peak_resident_bytes = std::max(peak_resident_bytes, resident.size() * tile_bytes);
+  return tile;
+}
+
+TileCache::Tile& TileCache::tile_for(size_t x, size_t y, size_t& offset) {
+  size_t tile_size = header.tile_size;
+  size_t id = (y / tile_size) * header.tiles_x + x / tile_size;
+  offset = (y % tile_size) * tile_size + x % tile_size;
+
+  // The last tile used is always at the front of the LRU list
+  if (last_tile && last_tile->id == id) {
+    return *last_tile;
+  }
+  auto found = resident.find(id);
+  Tile* tile;
+  if (found != resident.end()) {
+    tile = &found->second;
+    lru.splice(lru.begin(), lru, tile->lru_position);
+  } else {
+    tile = &load_tile(id);
+  }
+  last_tile = tile;
+  return *tile;
+}
+
+TiledCell TileCache::cell(size_t x, size_t y) {
+  size_t c;
+  const Tile& tile = tile_for(x, y, c);
+  TileLayout layout = tile_layout(header.tile_size);
+  return {
+    get<float>(tile.data, layout.elevation, c), get<float>(tile.data, layout.fwi, c),
+    get<float>(tile.data, layout.aspect, c), get<float>(tile.data, layout.vegetation_type, c),
+    get<float>(tile.data, layout.wind_dir, c), get<uint8_t>(tile.data, layout.burnable, c),
+  };
+}
+
+bool TileCache::burned(size_t x, size_t y) {
+  size_t c;
+  const Tile& tile = tile_for(x, y, c);
+  return get<uint32_t>(tile.data, tile_layout(header.tile_size).burn_tag, c) ==
+         uint32_t(header.burn_tag);
+}
+
+void TileCache::set_burned(size_t x, size_t y) {
+  size_t c;
+  Tile& tile = tile_for(x, y, c);
+  put<uint32_t>(tile.data, tile_layout(header.tile_size).burn_tag, c, header.burn_tag);
+  tile.dirty = true;
+}
+
+void TileCache::reset_burned() {
+  header.burn_tag++;
+  if (uint32_t(header.burn_tag) == 0) {
+    header.burn_tag++; // 0 is the tag of cells that never burned
+  }
+  write_header();
+}
+
+void TileCache::prefetch_around(const std::vector<uint64_t>& cells) {
+  size_t tile_size = header.tile_size;
+  std::vector<size_t> wanted;
+  for (uint64_t cell : cells) {
+    size_t x = cell % header.width;
+    size_t y = cell / header.width;
+    size_t tx_first = (x > 0 ? x - 1 : x) / tile_size;
+    size_t tx_last = std::min(x + 1, size_t(header.width - 1)) / tile_size;
+    size_t ty_first = (y > 0 ? y - 1 : y) / tile_size;
+    size_t ty_last = std::min(y + 1, size_t(header.height - 1)) / tile_size;
+    for (size_t ty = ty_first; ty <= ty_last; ty++) {
+      for (size_t tx = tx_first; tx <= tx_last; tx++) {
+        wanted.push_back(ty * header.tiles_x + tx);
+      }
+    }
+  }
+  std::sort(wanted.begin(), wanted.end());
+  wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+  for (size_t id : wanted) {
+    if (!resident.count(id)) {
+      posix_fadvise(fd, HEADER_BYTES + id * tile_bytes, tile_bytes, POSIX_FADV_WILLNEED);
+    }
+  }
+}
+
+TiledFire simulate_fire_tiled(
+    TileCache& tiles, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    int n_replicate, float upper_limit
+) {
+  auto start = std::chrono::steady_clock::now();
+
+  const int width = tiles.width();
+  const int height = tiles.height();
+  const uint64_t seed = replicate_seed(n_replicate);
+
+  TiledFire fire = { {}, {}, 0, 0.0 };
+  tiles.reset_burned();
+  for (auto [x, y] : ignition_cells) {
+    if (!tiles.burned(x, y)) {
+      tiles.set_burned(x, y);
+      fire.burned_ids.push_back(utils::INDEX(x, y, width));
+    }
+  }
+  fire.burned_ids_steps.push_back(fire.burned_ids.size());
+
+  size_t frontier_start = 0;
+  std::vector<uint64_t> frontier;
+  while (frontier_start < fire.burned_ids.size()) {
+    TRACE_SPAN("spread_step", "simulation", "step", fire.burned_ids_steps.size() - 1);
+    size_t end = fire.burned_ids.size();
+    frontier.assign(fire.burned_ids.begin() + frontier_start, fire.burned_ids.end());
+    tiles.prefetch_around(frontier);
+
+    for (uint64_t burning : frontier) {
+      int i = burning % width;
+      int j = burning / width;
+      TiledCell burning_cell = tiles.cell(i, j);
+
+      for (int n = 0; n < N_NEIGHBORS; n++) {
+        int ni = i + MOVES[n][0];
+        int nj = j + MOVES[n][1];
+        if (ni < 0 || nj < 0 || ni >= width || nj >= height) {
+          continue;
+        }
+        fire.processed_cells++;
+
+        if (tiles.burned(ni, nj)) {
+          continue;
+        }
+        TiledCell neighbor = tiles.cell(ni, nj);
+        if (!neighbor.burnable) {
+          continue;
+        }
+
+        float prob = spread_probability_cpu(
+            burning_cell.elevation, burning_cell.wind_dir, neighbor.elevation,
+            neighbor.vegetation_type, neighbor.fwi, neighbor.aspect, n, params, distance,
+            elevation_mean, elevation_sd, upper_limit
+        );
+        if (edge_uniform(seed, burning, n) < prob) {
+          tiles.set_burned(ni, nj);
+          fire.burned_ids.push_back(utils::INDEX(ni, nj, width));
+        }
+      }
+    }
+
+    frontier_start = end;
+    if (fire.burned_ids.size() > end) {
+      fire.burned_ids_steps.push_back(fire.burned_ids.size());
+    }
+  }
+
+  fire.time_taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return fire;
+}
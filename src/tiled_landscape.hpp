@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "spread_functions.cuh"
+
+/* Out-of-core landscapes.
+ *
+ * The landscape layers and the burn state are stored in a file as fixed-size square tiles. A
+ * TileCache keeps at most `ram_budget` bytes of tiles resident and pages them in on demand (least
+ * recently used tiles are evicted, writing back their burn state if it changed). The spread loop
+ * asks the kernel to read ahead the tiles around the frontier before every step, so most tile
+ * faults are served from the page cache.
+ *
+ * Burn state is stored as the tag of the last fire that burned the cell, so starting a new fire
+ * does not require clearing every tile.
+ */
+
+// Converts `<prefix>-metadata.csv` / `<prefix>-landscape.csv` into a tile file. Only one row of
+// tiles is kept in memory during the conversion.
+void convert_landscape_to_tiles(
+    std::string metadata_filename, std::string data_filename, std::string tiles_filename,
+    size_t tile_size
+);
+
+// Converts the landscape unless `tiles_filename` already holds it, with tiles of `tile_size`. The
+// tile file stores a hash of the landscape files it was converted from, so a file left over from an
+// older landscape is rebuilt.
+void update_landscape_tiles(
+    std::string metadata_filename, std::string data_filename, std::string tiles_filename,
+    size_t tile_size
+);
+
+struct TiledCell {
+  float elevation;
+  float fwi;
+  float aspect;
+  float vegetation_type;
+  float wind_dir;
+  uint8_t burnable;
+};
+
+class TileCache {
+public:
+  // A cell and its neighbours span up to four tiles, so `ram_budget` must hold at least four of
+  // them; a smaller budget throws.
+  TileCache(std::string tiles_filename, size_t ram_budget);
+  TileCache(const TileCache&) = delete;
+  ~TileCache();
+
+  size_t width() const {
+    return header.width;
+  }
+  size_t height() const {
+    return header.height;
+  }
+
+  TiledCell cell(size_t x, size_t y);
+  bool burned(size_t x, size_t y);
+  void set_burned(size_t x, size_t y);
+
+  // Starts a new fire: every cell is unburned again
+  void reset_burned();
+
+  // Asks the kernel to read ahead the tiles containing (or next to) the given cells
+  void prefetch_around(const std::vector<uint64_t>& cells);
+
+  // Writes back the burn state of every dirty tile
+  void flush();
+
+  size_t tile_loads = 0;
+  size_t tile_evictions = 0;
+  size_t peak_resident_bytes = 0;
+
+  struct Header {
+    uint64_t magic;
+    uint64_t width, height;
+    uint64_t tile_size;
+    uint64_t tiles_x, tiles_y;
+    uint64_t burn_tag; // tag of the current fire
+    uint64_t source_hash; // of the metadata and landscape files the tiles were converted from
+  };
+
+private:
+  struct Tile {
+    size_t id;
+    std::vector<char> data;
+    bool dirty;
+    std::list<size_t>::iterator lru_position;
+  };
+
+  Tile& tile_for(size_t x, size_t y, size_t& offset);
+  Tile& load_tile(size_t id);
+  void evict_tile();
+  void write_back(Tile& tile);
+  void write_header();
+
+  int fd;
+  Header header;
+  size_t tile_bytes;
+  size_t max_tiles;
+  std::unordered_map<size_t, Tile> resident;
+  std::list<size_t> lru; // most recently used first
+  Tile* last_tile = nullptr;
+};
+
+struct TiledFire {
+  std::vector<uint64_t> burned_ids; // linear indices, in the order they were burned
+  std::vector<size_t> burned_ids_steps; // positions in burned_ids where a new step starts
+  unsigned int processed_cells;
+  double time_taken;
+};
+
+// Same model and draws as `simulate_fire_cpu`, but reading the landscape through `tiles`
+TiledFire simulate_fire_tiled(
+    TileCache& tiles, const std::vector<std::pair<size_t, size_t>>& ignition_cells,
+    SimulationParams params, float distance, float elevation_mean, float elevation_sd,
+    int n_replicate, float upper_limit
+);
@@ -0,0 +1,146 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+namespace trace {
+
+namespace {
+
+struct Event {
+  const char* name;
+  const char* category;
+  const char* arg_name;
+  int64_t arg;
+  uint64_t start_us;
+  uint64_t duration_us;
+};
+
+// Events are stored in fixed-size chunks so that a buffer never reallocates what was already
+// recorded. Only the owning thread appends; `count` is published with release semantics.
+constexpr size_t CHUNK_EVENTS = 4096;
+
+struct Chunk {
+  Event events[CHUNK_EVENTS];
+  std::atomic<size_t> count{ 0 };
+  std::unique_ptr<Chunk> next;
+};
+
+struct ThreadBuffer {
+  uint32_t tid;
+  std::unique_ptr<Chunk> head = std::make_unique<Chunk>();
+  Chunk* tail = head.get();
+};
+
+const char* trace_filename = std::getenv("FIRE_SPREAD_TRACE");
+const auto process_start = std::chrono::steady_clock::now();
+
+// The registry is only locked the first time a thread records an event and when flushing
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer* register_thread() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.push_back(std::make_unique<ThreadBuffer>());
+  registry.back()->tid = registry.size() - 1;
+  return registry.back().get();
+}
+
+thread_local ThreadBuffer* local_buffer = nullptr;
+
+void write_escaped(std::ostream& out, const char* s) {
+  out << '"';
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      out << '\\';
+    }
+    out << *s;
+  }
+  out << '"';
+}
+
+} // namespace
+
+bool enabled() {
+  return trace_filename != nullptr;
+}
+
+uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - process_start
+  )
+      .count();
+}
+
+void record(
+    const char* name, const char* category, uint64_t start_us, uint64_t duration_us,
+    const char* arg_name, int64_t arg_value
+) {
+  if (local_buffer == nullptr) {
+    local_buffer = register_thread();
+  }
+  Chunk* chunk = local_buffer->tail;
+  size_t n = chunk->count.load(std::memory_order_relaxed);
+  if (n == CHUNK_EVENTS) {
+    chunk->next = std::make_unique<Chunk>();
+    chunk = chunk->next.get();
+    local_buffer->tail = chunk;
+    n = 0;
+  }
+  chunk->events[n] = { name, category, arg_name, arg_value, start_us, duration_us };
+  chunk->count.store(n + 1, std::memory_order_release);
+}
+
+void flush() {
+  if (!enabled()) {
+    return;
+  }
+
+  std::ofstream out(trace_filename);
+  if (!out.is_open()) {
+    std::cerr << "WARNING: can't open trace file " << trace_filename << std::endl;
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  long pid = getpid();
+  bool first = true;
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (const auto& buffer : registry) {
+    out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+        << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+    first = false;
+
+    for (const Chunk* chunk = buffer->head.get(); chunk; chunk = chunk->next.get()) {
+      size_t n = chunk->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < n; i++) {
+        const Event& e = chunk->events[i];
+        out << ",\n{\"ph\":\"X\",\"name\":";
+        write_escaped(out, e.name);
+        out << ",\"cat\":";
+        write_escaped(out, e.category);
+        out << ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us << ",\"pid\":" << pid
+            << ",\"tid\":" << buffer->tid;
+        if (e.arg_name) {
+          out << ",\"args\":{";
+          write_escaped(out, e.arg_name);
+          out << ":" << e.arg << "}";
+        }
+        out << "}";
+      }
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+}
+
+} // namespace trace
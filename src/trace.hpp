@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Timeline tracing of simulation runs.
+ *
+ * Scoped spans are recorded into per-thread buffers (no locks on the hot path) and flushed as
+ * Chrome/Perfetto trace-event JSON, which can be opened in chrome://tracing or ui.perfetto.dev.
+ *
+ * Tracing is off unless the environment variable FIRE_SPREAD_TRACE names the output file, e.g.
+ *   FIRE_SPREAD_TRACE=outputs/2021_865_trace.json ./graphics/burned_probabilities_data ...
+ * When it is off a span costs a single branch.
+ */
+
+namespace trace {
+
+// true if FIRE_SPREAD_TRACE is set
+bool enabled();
+
+// Microseconds since the start of the process
+uint64_t now_us();
+
+// Records a complete event. `name`, `category` and `arg_name` must be string literals (or
+// otherwise outlive the flush), only the pointers are stored.
+void record(
+    const char* name, const char* category, uint64_t start_us, uint64_t duration_us,
+    const char* arg_name, int64_t arg_value
+);
+
+// Writes every recorded event to the FIRE_SPREAD_TRACE file. Should be called once at the end of
+// the run, when no other thread is recording.
+void flush();
+
+class Span {
+public:
+  Span(const char* name, const char* category, const char* arg_name = nullptr, int64_t arg = 0)
+      : name(name), category(category), arg_name(arg_name), arg(arg),
+        start_us(enabled() ? now_us() : 0) {}
+
+  ~Span() {
+    if (enabled()) {
+      record(name, category, start_us, now_us() - start_us, arg_name, arg);
+    }
+  }
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+private:
+  const char* name;
+  const char* category;
+  const char* arg_name;
+  int64_t arg;
+  uint64_t start_us;
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// TRACE_SPAN("name", "category") or TRACE_SPAN("name", "category", "arg_name", value)
+#define TRACE_SPAN(...) trace::Span TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)